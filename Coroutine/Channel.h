@@ -0,0 +1,117 @@
+#ifndef __CORO_CHANNEL_H__
+#define __CORO_CHANNEL_H__
+
+#include <Arduino.h>
+#include <Coroutine.h>
+#include <RingBuffer.h>
+
+/*
+ * DECLARATION
+ */
+
+/*
+ * Bounded queue of N elements of T between coroutines of a same scheduler, a producer sending
+ * parsed URCs to a consumer for instance. A coroutine waiting on a full or an empty channel is
+ * parked on its event: it is not run again before the peer receives or sends.
+ *
+ *   Channel<int, 8> ch;
+ *   SEND(ch, value);  // yields while ch is full
+ *   RECV(ch, value);  // yields while ch is empty, then moves the first element to value
+ *
+ * Like WAIT_READY, both give up on the timeout of the coroutine.
+ */
+template<typename T, uint32_t N>
+class Channel {
+public:
+	typedef typename RingBuffer<N, T>::size_type size_type;
+
+	/* false and nothing sent when full */
+	bool send(T value);
+
+	/* false and value untouched when empty */
+	bool recv(T* value);
+
+	bool full() const;
+
+	bool empty() const;
+
+	size_type length() const;
+
+	static size_type capacity();
+
+	/*
+	 * signaled by a send on an empty channel: a receiver can only be parked on an empty one,
+	 * and once signaled it stays due until it runs
+	 */
+	CoroEvent& readable();
+
+	/* signaled by a recv on a full channel */
+	CoroEvent& writable();
+
+private:
+	RingBuffer<N, T> _ring;
+	CoroEvent _readable;
+	CoroEvent _writable;
+};
+
+#define SEND(ch, value) WAIT_READY((ch).writable(), (ch).send(value))
+
+#define RECV(ch, value) WAIT_READY((ch).readable(), (ch).recv(&(value)))
+
+/*
+ * IMPLEMENTATION
+ */
+
+template<typename T, uint32_t N>
+bool Channel<T, N>::send(T value) {
+	if (_ring.full())
+		return false;
+	bool was_empty = _ring.empty();
+	_ring.append(value);
+	if (was_empty)
+		_readable.signal();
+	return true;
+}
+
+template<typename T, uint32_t N>
+bool Channel<T, N>::recv(T* value) {
+	if (_ring.empty())
+		return false;
+	bool was_full = _ring.full();
+	*value = _ring.pop_first();
+	if (was_full)
+		_writable.signal();
+	return true;
+}
+
+template<typename T, uint32_t N>
+bool Channel<T, N>::full() const {
+	return _ring.full();
+}
+
+template<typename T, uint32_t N>
+bool Channel<T, N>::empty() const {
+	return _ring.empty();
+}
+
+template<typename T, uint32_t N>
+typename Channel<T, N>::size_type Channel<T, N>::length() const {
+	return _ring.length();
+}
+
+template<typename T, uint32_t N>
+typename Channel<T, N>::size_type Channel<T, N>::capacity() {
+	return N;
+}
+
+template<typename T, uint32_t N>
+CoroEvent& Channel<T, N>::readable() {
+	return _readable;
+}
+
+template<typename T, uint32_t N>
+CoroEvent& Channel<T, N>::writable() {
+	return _writable;
+}
+
+#endif
@@ -0,0 +1,316 @@
+#ifndef __CORO_ASYNC_H__
+#define __CORO_ASYNC_H__
+
+#ifdef __AVR__
+#error "CoroAsync is only available on the host build"
+#endif
+
+#if __cplusplus < 202002L
+#error "CoroAsync needs C++20 coroutines, compile this file with -std=c++20"
+#endif
+
+#include <coroutine>
+#include <exception>
+#include <stddef.h>
+#include <utility>
+
+#include <Arduino.h>
+#include <Coroutine.h>
+
+/*
+ * DECLARATION
+ */
+
+/*
+ * The frames of the CoroAsync coroutines come from a static arena of fixed size blocks instead
+ * of the heap, like CoroPool for the COROUTINE() classes. A frame larger than a block, or
+ * an exhausted arena, gives a coroutine born timed out.
+ */
+#ifndef CORO_ARENA_BLOCKS
+#define CORO_ARENA_BLOCKS 512
+#endif
+
+#ifndef CORO_ARENA_BLOCK_SIZE
+#define CORO_ARENA_BLOCK_SIZE 512
+#endif
+
+class CoroArena {
+public:
+	/* nullptr when exhausted or size is larger than a block */
+	static void* allocate(size_t size);
+	static void release(void* block);
+
+	static uint32_t allocations();
+	static uint32_t exhausted();
+	static uint16_t in_use();
+	static uint16_t peak();
+	static uint16_t capacity();
+	/* largest frame requested, to size CORO_ARENA_BLOCK_SIZE */
+	static size_t largest();
+	static void reset_stats();
+
+private:
+	union Block {
+		Block* next;
+		alignas(std::max_align_t) unsigned char data[CORO_ARENA_BLOCK_SIZE];
+	};
+
+	struct State {
+		Block blocks[CORO_ARENA_BLOCKS];
+		Block* free;
+		uint32_t allocations;
+		uint32_t exhausted;
+		uint16_t in_use;
+		uint16_t peak;
+		size_t largest;
+
+		State();
+	};
+
+	static State& _state();
+};
+
+/* co_await coro_yield(): same as YIELD() */
+inline std::suspend_always coro_yield() {
+	return std::suspend_always();
+}
+
+/*
+ * C++20 coroutine with the contract of the COROUTINE() classes: live(), run(), result(),
+ * has_timeout(), a timeout counted from the creation, and nested awaits. The locals are
+ * plain locals, there is no CORO_VAR.
+ *
+ *   CoroAsync<int> count_number(int limit) {
+ *       for (int count = 0; count < limit; ++count)
+ *           co_await coro_yield();
+ *       co_return limit;
+ *   }
+ *
+ *   CoroAsync<int> sub = count_number(10);
+ *   int value = co_await sub; // AWAIT() then RESULT(), sub.has_timeout() is HAS_TIMEOUT()
+ *
+ * Being an ICoroutine, it can be given to schedule_coro().
+ */
+template<typename T>
+class CoroAsync: public ICoroutine {
+public:
+	struct promise_type {
+		T value {};
+		CoroAsync* owner = nullptr; // set on each run, the object may have been moved
+
+		CoroAsync get_return_object() {
+			return CoroAsync(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+		static CoroAsync get_return_object_on_allocation_failure() {
+			return CoroAsync(nullptr);
+		}
+		std::suspend_always initial_suspend() noexcept {
+			return std::suspend_always();
+		}
+		std::suspend_always final_suspend() noexcept {
+			return std::suspend_always();
+		}
+		void return_value(T result) {
+			value = std::move(result);
+		}
+		void unhandled_exception() {
+			std::terminate();
+		}
+		static void* operator new(size_t size) noexcept {
+			return CoroArena::allocate(size);
+		}
+		static void operator delete(void* frame) {
+			CoroArena::release(frame);
+		}
+	};
+
+	typedef std::coroutine_handle<promise_type> handle_type;
+
+	explicit CoroAsync(handle_type handle);
+	CoroAsync(CoroAsync&& other);
+	virtual ~CoroAsync();
+
+	/* in ms from the creation, TIMEOUT_MS by default */
+	CoroAsync& timeout(unsigned long timeout_ms) &;
+	CoroAsync&& timeout(unsigned long timeout_ms) &&;
+
+	T result() const;
+
+	virtual void run();
+
+	/* co_await: runs it once per run of the awaiting coroutine until it ends */
+	bool await_ready() const;
+	template<typename P>
+	bool await_suspend(std::coroutine_handle<P> awaiting);
+	T await_resume() const;
+
+private:
+	template<typename > friend class CoroAsync;
+
+	CoroAsync(const CoroAsync&);
+	CoroAsync& operator=(const CoroAsync&);
+
+	handle_type _handle;
+};
+
+/*
+ * IMPLEMENTATION
+ */
+
+inline CoroArena::State::State() :
+		free(&blocks[0]), allocations(0), exhausted(0), in_use(0), peak(0), largest(0) {
+	for (uint16_t i = 0; i < CORO_ARENA_BLOCKS; ++i)
+		blocks[i].next = i + 1 < CORO_ARENA_BLOCKS ? &blocks[i + 1] : nullptr;
+}
+
+inline CoroArena::State& CoroArena::_state() {
+	static State state;
+	return state;
+}
+
+inline void* CoroArena::allocate(size_t size) {
+	State& state = _state();
+	if (size > state.largest)
+		state.largest = size;
+	if (state.free == nullptr || size > sizeof(Block)) {
+		++state.exhausted;
+		return nullptr;
+	}
+	Block* block = state.free;
+	state.free = block->next;
+	++state.allocations;
+	if (++state.in_use > state.peak)
+		state.peak = state.in_use;
+	return block;
+}
+
+inline void CoroArena::release(void* block) {
+	if (block == nullptr)
+		return;
+	State& state = _state();
+	Block* freed = (Block*) block;
+	freed->next = state.free;
+	state.free = freed;
+	--state.in_use;
+}
+
+inline uint32_t CoroArena::allocations() {
+	return _state().allocations;
+}
+
+inline uint32_t CoroArena::exhausted() {
+	return _state().exhausted;
+}
+
+inline uint16_t CoroArena::in_use() {
+	return _state().in_use;
+}
+
+inline uint16_t CoroArena::peak() {
+	return _state().peak;
+}
+
+inline uint16_t CoroArena::capacity() {
+	return CORO_ARENA_BLOCKS;
+}
+
+inline size_t CoroArena::largest() {
+	return _state().largest;
+}
+
+inline void CoroArena::reset_stats() {
+	State& state = _state();
+	state.allocations = 0;
+	state.exhausted = 0;
+	state.peak = state.in_use;
+	state.largest = 0;
+}
+
+template<typename T>
+CoroAsync<T>::CoroAsync(handle_type handle) :
+		ICoroutine(TIMEOUT_MS), _handle(handle) {
+	if (!_handle) {
+		// no frame: born timed out, AWAIT of it returns at once as for a nullptr COROUTINE()
+		_live = false;
+		_has_timeout = true;
+	}
+}
+
+template<typename T>
+CoroAsync<T>::CoroAsync(CoroAsync&& other) :
+		ICoroutine(other), _handle(other._handle) {
+	// the owned links go with the object, other keeps nothing to delete
+	other._handle = nullptr;
+	other._subtask = nullptr;
+	other._sibling = nullptr;
+	other._await_lost = 0;
+	other._event = nullptr;
+	other._live = false;
+}
+
+template<typename T>
+CoroAsync<T>::~CoroAsync() {
+	_subtask = nullptr; // awaited, not owned: ~ICoroutine must not delete it
+	if (_handle)
+		_handle.destroy();
+}
+
+template<typename T>
+CoroAsync<T>& CoroAsync<T>::timeout(unsigned long timeout_ms) & {
+	_timeout_ms = timeout_ms;
+	return *this;
+}
+
+template<typename T>
+CoroAsync<T>&& CoroAsync<T>::timeout(unsigned long timeout_ms) && {
+	_timeout_ms = timeout_ms;
+	return std::move(*this);
+}
+
+template<typename T>
+T CoroAsync<T>::result() const {
+	return _handle ? _handle.promise().value : T();
+}
+
+template<typename T>
+void CoroAsync<T>::run() {
+	if (_live && coro_expired(_start, _timeout_ms, coro_now())) {
+		_has_timeout = true;
+		_live = false;
+	}
+	if (!_live)
+		return;
+	if (_subtask != nullptr) {
+		_subtask->run();
+		_wake = _subtask->wake();
+		if (_subtask->live())
+			return;
+		_subtask = nullptr;
+	}
+	_handle.promise().owner = this;
+	_handle.resume();
+	if (_handle.done())
+		_live = false;
+}
+
+template<typename T>
+bool CoroAsync<T>::await_ready() const {
+	return !_live;
+}
+
+template<typename T>
+template<typename P>
+bool CoroAsync<T>::await_suspend(std::coroutine_handle<P> awaiting) {
+	run();
+	if (!_live)
+		return false; // done in one run, the awaiting coroutine goes on
+	awaiting.promise().owner->_subtask = this;
+	return true;
+}
+
+template<typename T>
+T CoroAsync<T>::await_resume() const {
+	return result();
+}
+
+#endif
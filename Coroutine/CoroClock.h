@@ -0,0 +1,67 @@
+#ifndef __CORO_CLOCK__
+#define __CORO_CLOCK__
+
+#include <Arduino.h>
+
+/*
+ * Time of the coroutines, in ms. A scheduler pass reads millis() once and the coroutines it
+ * runs share that tick through coro_now(), instead of a clock read per coroutine per pass.
+ * Out of a pass, coro_now() is millis().
+ *
+ * The ms counter wraps after 49 days: compare the times with the helpers below only.
+ */
+
+/* a is before b, valid for times less than 24 days apart */
+inline bool coro_before(unsigned long a, unsigned long b) {
+	return (long) (a - b) < 0;
+}
+
+/*
+ * more than timeout_ms elapsed from start to now: the timeout check of the coroutines.
+ * A now before start, a tick older than the one of the thread which started it, is not expired
+ */
+inline bool coro_expired(unsigned long start, unsigned long timeout_ms, unsigned long now) {
+	return !coro_before(now, start + timeout_ms + 1);
+}
+
+/* each scheduler thread has its own pass */
+#ifdef __AVR__
+#define CORO_THREAD_LOCAL
+#else
+#define CORO_THREAD_LOCAL thread_local
+#endif
+
+struct _CoroTick {
+	unsigned long now;
+	uint8_t depth;  // nested passes, the outermost one reads the clock
+};
+
+inline _CoroTick& _coro_tick() {
+	static CORO_THREAD_LOCAL _CoroTick tick;
+	return tick;
+}
+
+/* the tick of the current pass, millis() out of a pass */
+inline unsigned long coro_now() {
+	_CoroTick& tick = _coro_tick();
+	return tick.depth != 0 ? tick.now : millis();
+}
+
+/* scope of a scheduler pass */
+class CoroPass {
+public:
+	CoroPass() {
+		_CoroTick& tick = _coro_tick();
+		if (tick.depth++ == 0)
+			tick.now = millis();
+	}
+	~CoroPass() {
+		--_coro_tick().depth;
+	}
+	/* read the clock again, for a scheduler without clear passes */
+	static void refresh() {
+		_coro_tick().now = millis();
+	}
+};
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef __CORO_CTX_SCHEDULER_H__
+#define __CORO_CTX_SCHEDULER_H__
+
+#ifdef __AVR__
+#error "CoroCtxScheduler is only available on the host build"
+#endif
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <Arduino.h>
+#include <CoroutineCtx.h>
+
+/*
+ * DECLARATION
+ */
+
+/* spawn the coroutine fct_name on its initialized ctx */
+#define CORO_SPAWN(scheduler, fct_name, ctx) \
+	(scheduler).spawn(&(ctx), &coro_task_run<fct_name ## Ctx, fct_name>)
+
+/*
+ * Runs CoroCtx coroutines on several threads, for the host simulations.
+ * Each worker has its own run queue and runs its coroutines in turn, a live coroutine goes
+ * back to the queue of the worker which ran it. An idle worker steals half of the queue of
+ * another one, except the coroutines inside an AWAIT_CTX which stay on their thread.
+ */
+class CoroCtxScheduler {
+public:
+	CoroCtxScheduler(uint8_t workers = std::thread::hardware_concurrency());
+	~CoroCtxScheduler();
+
+	/* queue a coroutine, on a given worker or spread round robin. Also from a running coroutine */
+	void spawn(CoroCtx* ctx, void (*fct)(CoroCtx&), int16_t worker = -1);
+
+	/* run on the workers threads until all the spawned coroutines are done */
+	void run();
+
+	uint8_t workers() const;
+	/* number of runs of coroutines, and of coroutines stolen, since the creation */
+	uint64_t runs() const;
+	uint64_t steals() const;
+
+private:
+	struct Worker {
+		std::mutex mutex;
+		std::deque<CoroTask> queue;
+		uint64_t runs;
+		uint64_t steals;
+	};
+
+	CoroCtxScheduler(const CoroCtxScheduler&);
+	CoroCtxScheduler& operator=(const CoroCtxScheduler&);
+
+	void _work(uint8_t idx);
+	bool _pop(uint8_t idx, CoroTask* task);
+	bool _steal(uint8_t idx, CoroTask* task);
+
+	std::vector<Worker*> _workers;
+	std::atomic<uint32_t> _live; // spawned and not done
+	std::atomic<uint32_t> _next; // round robin of spawn
+};
+
+/*
+ * IMPLEMENTATION
+ */
+
+inline CoroCtxScheduler::CoroCtxScheduler(uint8_t workers) :
+		_live(0), _next(0) {
+	if (workers == 0)
+		workers = 1;
+	for (uint8_t i = 0; i < workers; ++i) {
+		Worker* worker = new Worker();
+		worker->runs = 0;
+		worker->steals = 0;
+		_workers.push_back(worker);
+	}
+}
+
+inline CoroCtxScheduler::~CoroCtxScheduler() {
+	for (size_t i = 0; i < _workers.size(); ++i)
+		delete _workers[i];
+}
+
+inline void CoroCtxScheduler::spawn(CoroCtx* ctx, void (*fct)(CoroCtx&), int16_t worker) {
+	if (worker < 0 || worker >= (int16_t) _workers.size())
+		worker = _next.fetch_add(1, std::memory_order_relaxed) % _workers.size();
+	CoroTask task = {ctx, fct};
+	_live.fetch_add(1, std::memory_order_relaxed);
+	std::lock_guard<std::mutex> lock(_workers[worker]->mutex);
+	_workers[worker]->queue.push_back(task);
+}
+
+inline void CoroCtxScheduler::run() {
+	std::vector<std::thread> threads;
+	for (uint8_t i = 1; i < _workers.size(); ++i)
+		threads.push_back(std::thread(&CoroCtxScheduler::_work, this, i));
+	_work(0);
+	for (size_t i = 0; i < threads.size(); ++i)
+		threads[i].join();
+}
+
+inline uint8_t CoroCtxScheduler::workers() const {
+	return _workers.size();
+}
+
+inline uint64_t CoroCtxScheduler::runs() const {
+	uint64_t count = 0;
+	for (size_t i = 0; i < _workers.size(); ++i)
+		count += _workers[i]->runs;
+	return count;
+}
+
+inline uint64_t CoroCtxScheduler::steals() const {
+	uint64_t count = 0;
+	for (size_t i = 0; i < _workers.size(); ++i)
+		count += _workers[i]->steals;
+	return count;
+}
+
+inline void CoroCtxScheduler::_work(uint8_t idx) {
+	Worker* worker = _workers[idx];
+	CoroTask task;
+	CoroPass pass; // no pass over a queue changing under steals: the clock is read every 64 runs
+	while (_live.load(std::memory_order_acquire) != 0) {
+		if (!_pop(idx, &task) && !_steal(idx, &task)) {
+			std::this_thread::yield();
+			CoroPass::refresh();
+			continue;
+		}
+		if ((worker->runs & 63) == 0)
+			CoroPass::refresh();
+		task.fct(*task.ctx);
+		++worker->runs;
+		if (task.ctx->_live) {
+			std::lock_guard<std::mutex> lock(worker->mutex);
+			worker->queue.push_back(task);
+		} else {
+			_live.fetch_sub(1, std::memory_order_release);
+		}
+	}
+}
+
+inline bool CoroCtxScheduler::_pop(uint8_t idx, CoroTask* task) {
+	Worker* worker = _workers[idx];
+	std::lock_guard<std::mutex> lock(worker->mutex);
+	if (worker->queue.empty())
+		return false;
+	*task = worker->queue.front();
+	worker->queue.pop_front();
+	return true;
+}
+
+/* half of the first victim with something to take, from the back of its queue */
+inline bool CoroCtxScheduler::_steal(uint8_t idx, CoroTask* task) {
+	std::vector<CoroTask> stolen;
+	for (uint8_t i = 1; i < _workers.size() && stolen.empty(); ++i) {
+		Worker* victim = _workers[(idx + i) % _workers.size()];
+		std::lock_guard<std::mutex> lock(victim->mutex);
+		size_t wanted = (victim->queue.size() + 1) / 2;
+		size_t pinned = 0;
+		for (size_t scan = victim->queue.size(); scan > 0 && stolen.size() < wanted; --scan) {
+			CoroTask back = victim->queue.back();
+			victim->queue.pop_back();
+			if (back.ctx->_awaiting) {
+				victim->queue.push_front(back); // rotated, scanned once
+				++pinned;
+			} else {
+				stolen.push_back(back);
+			}
+		}
+		// the pinned ones go back where they were, at the back
+		for (; pinned > 0; --pinned) {
+			victim->queue.push_back(victim->queue.front());
+			victim->queue.pop_front();
+		}
+	}
+	if (stolen.empty())
+		return false;
+	Worker* worker = _workers[idx];
+	*task = stolen[0];
+	std::lock_guard<std::mutex> lock(worker->mutex);
+	worker->steals += stolen.size();
+	worker->queue.insert(worker->queue.end(), stolen.begin() + 1, stolen.end());
+	return true;
+}
+
+#endif
@@ -1,58 +1,299 @@
-// Coroutines.cpp : Defines the entry point for the console application.
-//
-
-#include <list>
-#include <stdio.h>
-#include "Coroutine.h"
-#include "Arduino.h"
-
-//////////// EXAMPLE OF ASYNC Delay implementation ////////////
-/*
- * This coroutine will simply exit when timing out
- */
-
-CORO_START(Delay)
-{
-	while (true)
-		YIELD()
-}
-CORO_RETURN(0)
-CORO_END()
-
-
-//////////// EXAMPLE OF MAIN SCHEDULING LOOP implementation ////////////
-/*
- * It can be the only thing you have the call from the arduino loop() function
- */
-
-void schedule_coro(ICoroutine* coroutines[], uint8_t size, coro_callback clbk) {
-	bool has_coro = true;
-	while (has_coro) {
-		has_coro = false;
-		for (uint8_t idx = 0; idx < size; ++idx) {
-			ICoroutine* coro = coroutines[idx];
-			if (coro == nullptr)
-				continue;
-			has_coro = true;
-			if (coro->live()) {
-				coro->run();
-			} else {
-				clbk(idx, coro);
-				delete coro;
-				coroutines[idx] = nullptr;
-			}
-		}
-	}
-}
-
-///////////////////////////////////////////////////////////////////////
-
-//http://en.cppreference.com/w/cpp/memory/new/operator_delete
-/*
-*  TODO: overload new.
-* if free_ram() too small, redirect to default TIMEOUT error result
-* overload delete
-* if default TIMEOUT error, do not free
-*/
-
-///////////////////////////////////////////////////////////////////////
+// Coroutines.cpp : Defines the entry point for the console application.
+//
+
+#include <list>
+#include <stdio.h>
+#include "Coroutine.h"
+#include "Arduino.h"
+
+#ifdef __AVR__
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#else
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#endif
+
+//////////// EXAMPLE OF ASYNC Delay implementation ////////////
+/*
+ * This coroutine will simply exit when timing out, without being run in between
+ */
+
+CORO_START(Delay)
+{
+	while (true)
+		SLEEP(_timeout_ms)
+}
+CORO_RETURN(0)
+CORO_END()
+
+
+//////////// EXAMPLE OF MAIN SCHEDULING LOOP implementation ////////////
+/*
+ * It can be the only thing you have the call from the arduino loop() function
+ */
+
+uint8_t schedule_coro(ICoroutine* coroutines[], uint8_t size, coro_callback clbk) {
+	unsigned long next_wake;
+	uint8_t empty = 0;
+	for (uint8_t idx = 0; idx < size; ++idx)
+		if (coroutines[idx] == nullptr)
+			++empty;
+	while (schedule_coro_once(coroutines, size, clbk, &next_wake) != 0)
+		coro_sleep_until(next_wake);
+	return empty;
+}
+
+uint8_t schedule_coro_once(ICoroutine* coroutines[], uint8_t size, coro_callback clbk,
+		unsigned long* next_wake) {
+	uint8_t count = 0;
+	CoroPass pass; // one clock read for the whole pass
+	unsigned long now = coro_now();
+	for (uint8_t idx = 0; idx < size; ++idx) {
+		ICoroutine* coro = coroutines[idx];
+		if (coro == nullptr)
+			continue;
+		if (coro->live() && coro->due(now))
+			coro->run();
+		if (!coro->live()) {
+			clbk(idx, coro);
+			delete coro;
+			coroutines[idx] = nullptr;
+			continue;
+		}
+		if (count == 0 || coro_before(coro->wake(), *next_wake))
+			*next_wake = coro->wake();
+		++count;
+	}
+	return count;
+}
+
+#ifdef __AVR__
+
+static volatile bool g_coro_notified = false;
+
+void coro_sleep_until(unsigned long deadline) {
+	// woken up by any interrupt, at least the millis() timer
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	while (coro_before(millis(), deadline)) {
+		cli();
+		if (g_coro_notified) {
+			sei();
+			break;
+		}
+		sleep_enable();
+		sei(); // the instruction after sei is executed before any interrupt: no lost wake up
+		sleep_cpu();
+		sleep_disable();
+	}
+	g_coro_notified = false;
+}
+
+void coro_notify() {
+	g_coro_notified = true;
+}
+
+void CoroEvent::signal() {
+	_count = _count + 1;
+	coro_notify();
+}
+
+#else
+
+static std::mutex g_coro_mutex;
+static std::condition_variable g_coro_cond;
+static bool g_coro_notified = false;
+
+void coro_sleep_until(unsigned long deadline) {
+	std::unique_lock<std::mutex> lock(g_coro_mutex);
+	// the wait is on the steady clock, millis() may be coarser: wait again until it is reached
+	for (unsigned long now = millis(); !g_coro_notified && coro_before(now, deadline); now = millis())
+		g_coro_cond.wait_for(lock, std::chrono::milliseconds(deadline - now));
+	g_coro_notified = false;
+}
+
+void coro_notify() {
+	std::lock_guard<std::mutex> lock(g_coro_mutex);
+	g_coro_notified = true;
+	g_coro_cond.notify_all();
+}
+
+void CoroEvent::signal() {
+	_count.fetch_add(1, std::memory_order_release);
+	coro_notify();
+}
+
+#endif
+
+//////////// POOL OF COROUTINES ////////////
+/*
+ * The free blocks are chained through their first bytes.
+ */
+
+union CoroBlock {
+	CoroBlock* next;
+	uint8_t data[CORO_POOL_BLOCK_SIZE];
+	unsigned long align_long; // alignment of the coroutine members
+	void* align_ptr;
+};
+
+static CoroBlock g_coro_blocks[CORO_POOL_BLOCKS];
+static CoroBlock* g_coro_free = nullptr;
+static bool g_coro_pool_init = false;
+static uint32_t g_coro_allocations = 0;
+static uint32_t g_coro_exhausted = 0;
+static uint16_t g_coro_in_use = 0;
+static uint16_t g_coro_peak = 0;
+
+void* CoroPool::allocate(size_t size) {
+	if (!g_coro_pool_init) {
+		for (uint16_t i = 0; i < CORO_POOL_BLOCKS; ++i)
+			g_coro_blocks[i].next = i + 1 < CORO_POOL_BLOCKS ? &g_coro_blocks[i + 1] : nullptr;
+		g_coro_free = &g_coro_blocks[0];
+		g_coro_pool_init = true;
+	}
+	if (g_coro_free == nullptr || size > sizeof(CoroBlock)) {
+		++g_coro_exhausted;
+		return nullptr;
+	}
+	CoroBlock* block = g_coro_free;
+	g_coro_free = block->next;
+	++g_coro_allocations;
+	if (++g_coro_in_use > g_coro_peak)
+		g_coro_peak = g_coro_in_use;
+	return block;
+}
+
+void CoroPool::release(void* block) {
+	if (block == nullptr)
+		return;
+	CoroBlock* freed = (CoroBlock*) block;
+	freed->next = g_coro_free;
+	g_coro_free = freed;
+	--g_coro_in_use;
+}
+
+uint32_t CoroPool::allocations() {
+	return g_coro_allocations;
+}
+
+uint32_t CoroPool::exhausted() {
+	return g_coro_exhausted;
+}
+
+uint16_t CoroPool::in_use() {
+	return g_coro_in_use;
+}
+
+uint16_t CoroPool::peak() {
+	return g_coro_peak;
+}
+
+uint16_t CoroPool::capacity() {
+	return CORO_POOL_BLOCKS;
+}
+
+void CoroPool::reset_stats() {
+	g_coro_allocations = 0;
+	g_coro_exhausted = 0;
+	g_coro_peak = g_coro_in_use;
+}
+
+//////////// AWAIT_ALL / AWAIT_ANY ////////////
+/*
+ * The subtasks are chained through _sibling, the head in _subtask, so deleting the head
+ * deletes them all. The nullptr ones, from an exhausted pool, are flagged in _await_lost
+ * instead.
+ */
+
+bool ICoroutine::_signaled() const {
+	if (_event != nullptr && _event->count() != _event_seen)
+		return true;
+	for (const ICoroutine* sub = _subtask; sub != nullptr; sub = sub->_sibling)
+		if (sub->_signaled())
+			return true;
+	return false;
+}
+
+void ICoroutine::_await_reset() {
+	if (_subtask != nullptr)
+		delete _subtask;
+	_subtask = nullptr;
+	_await_lost = 0;
+	_subtask_lost = false;
+}
+
+void ICoroutine::_await_link(ICoroutine* subtasks[], uint8_t size) {
+	_await_reset();
+	ICoroutine** link = &_subtask;
+	for (uint8_t i = 0; i < size; ++i) {
+		if (subtasks[i] == nullptr) {
+			_await_lost |= 1 << i;
+			continue;
+		}
+		*link = subtasks[i];
+		link = &subtasks[i]->_sibling;
+	}
+}
+
+bool ICoroutine::_await_run() {
+	bool ran = false;
+	for (ICoroutine* sub = _subtask; sub != nullptr; sub = sub->_sibling) {
+		if (!sub->live())
+			continue;
+		sub->run();
+		if (!ran || coro_before(sub->wake(), _wake))
+			_wake = sub->wake();
+		ran = true;
+	}
+	return ran;
+}
+
+int8_t ICoroutine::_await_first() {
+	ICoroutine* winner = nullptr;
+	bool lost = false;
+	int8_t idx = 0;
+	for (ICoroutine* sub = _subtask; sub != nullptr || (_await_lost >> idx) != 0; ++idx) {
+		if ((_await_lost >> idx) & 1) {
+			lost = true; // never allocated: done at once
+			break;
+		}
+		if (!sub->live()) {
+			winner = sub;
+			break;
+		}
+		sub = sub->_sibling;
+	}
+	if (winner == nullptr && !lost)
+		return -1;
+	// cancel the others: the winner is unlinked, the rest of the chain deleted
+	for (ICoroutine** link = &_subtask; *link != nullptr; link = &(*link)->_sibling) {
+		if (*link == winner) {
+			*link = winner->_sibling;
+			winner->_sibling = nullptr;
+			break;
+		}
+	}
+	if (_subtask != nullptr)
+		delete _subtask;
+	_subtask = winner;
+	_subtask_lost = lost;
+	_await_lost = 0;
+	return idx;
+}
+
+ICoroutine* ICoroutine::_await_get(uint8_t idx) {
+	if ((_await_lost >> idx) & 1)
+		return nullptr;
+	ICoroutine* sub = _subtask;
+	for (uint8_t i = 0; i < idx; ++i)
+		if (!((_await_lost >> i) & 1))
+			sub = sub->_sibling;
+	return sub;
+}
+
+bool ICoroutine::_await_timeout(uint8_t idx) {
+	ICoroutine* sub = _await_get(idx);
+	return sub == nullptr || sub->has_timeout();
+}
@@ -2,14 +2,94 @@
 #define __COROUTINE__
 
 #include <Arduino.h>
+#include <CoroClock.h>
+#include <stddef.h>
+
+#ifdef __AVR__
+#include <util/atomic.h>
+#else
+#include <atomic>
+#endif
 
 #define TIMEOUT_MS 5 * 1000
 
+/*
+ * The coroutines declared with COROUTINE() are allocated from a static pool of fixed size
+ * blocks instead of the heap. Both sizes can be overridden from the compiler flags, the
+ * same for every file. Each coroutine class checks at compile time that it fits a block.
+ */
+#ifndef CORO_POOL_BLOCKS
+#define CORO_POOL_BLOCKS 8
+#endif
+
+#ifndef CORO_POOL_BLOCK_SIZE
+#define CORO_POOL_BLOCK_SIZE (sizeof(ICoroutine) + 4 * sizeof(unsigned long))
+#endif
+
+/*
+ * O(1) allocation from a free list. When the pool is exhausted, allocate returns nullptr:
+ * new gives nullptr without running the constructor, and AWAIT of it returns at once with
+ * HAS_TIMEOUT() true. CORO_NEW sets the CORO_ARG of a successful allocation only.
+ */
+class CoroPool {
+public:
+	/* nullptr when exhausted */
+	static void* allocate(size_t size);
+	/* no-op on nullptr */
+	static void release(void* block);
+
+	/* number of successful allocations */
+	static uint32_t allocations();
+	/* number of allocations that got nullptr */
+	static uint32_t exhausted();
+	static uint16_t in_use();
+	/* highest in_use() since the start or the last reset_stats() */
+	static uint16_t peak();
+	static uint16_t capacity();
+	static void reset_stats();
+};
+
+/*
+ * Readiness source, like "the RX ring got data". The producer, an ISR or a reader thread,
+ * calls signal() after appending. The coroutines parked on it with WAIT_READY are not run
+ * in between, and a scheduler sleeping in coro_sleep_until is woken up.
+ * A single producer per event.
+ */
+class CoroEvent {
+public:
+	CoroEvent() :
+			_count(0) {
+	}
+	void signal();
+	/*
+	 * changes on every signal. 16 bits: a byte per signal at 115200 bauds takes 5.7 s to come
+	 * back to the same count, a parked coroutine does not miss the signals in between
+	 */
+	uint16_t count() const {
+#ifdef __AVR__
+		uint16_t count;
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+			count = _count;
+		}
+		return count;
+#else
+		return _count;
+#endif
+	}
+private:
+#ifdef __AVR__
+	volatile uint16_t _count;  // incremented by the ISR: read with the interrupts off
+#else
+	std::atomic<uint16_t> _count;
+#endif
+};
+
 class ICoroutine {
 public:
 	ICoroutine(unsigned long timeout_ms) :
-			_live(true), _state(0), _has_timeout(false), _start(millis()), _timeout_ms(
-					timeout_ms), _subtask(nullptr) {
+			_live(true), _state(0), _has_timeout(false), _start(coro_now()), _timeout_ms(timeout_ms), _subtask(
+					nullptr), _wake(_start), _event(nullptr), _event_seen(0), _sibling(nullptr), _await_lost(0), _subtask_lost(
+					false) {
 	}
 
 	bool live() {
@@ -22,10 +102,24 @@ public:
 		return _has_timeout;
 	}
 
+	/* coro_now() from which run() has something to do: the end of a SLEEP or the timeout */
+	unsigned long wake() const {
+		unsigned long timeout = _start + _timeout_ms + 1;
+		return coro_before(_wake, timeout) ? _wake : timeout;
+	}
+
+	/* has something to do at now: wake() is reached or the event it waits for, or its subtask, got signaled */
+	bool due(unsigned long now) const {
+		return !coro_before(now, wake()) || _signaled();
+	}
+
 	virtual ~ICoroutine() {
 		if (_subtask != nullptr) {
 			delete _subtask;
 		}
+		if (_sibling != nullptr) {
+			delete _sibling;
+		}
 	}
 
 protected:
@@ -35,6 +129,31 @@ protected:
 	unsigned long _start;  // start timestamp
 	unsigned long _timeout_ms;  // timeout value
 	ICoroutine* _subtask;  // holder for a sub-coroutine inside a coroutine
+	unsigned long _wake;  // no need to run before, in the past when due
+	CoroEvent* _event;  // parked on it by WAIT_READY
+	uint16_t _event_seen;  // _event->count() when condition was last checked
+	ICoroutine* _sibling;  // next subtask of the same AWAIT_ALL / AWAIT_ANY, owned
+	uint8_t _await_lost;  // bit i: subtask i was never allocated, not chained
+	bool _subtask_lost;  // the awaited subtask was never allocated: timed out, default result
+
+	/* the event it, or one of its subtasks, waits for got signaled */
+	bool _signaled() const;
+
+	/* delete the previous subtasks, before allocating the new ones */
+	void _await_reset();
+	/* chain the subtasks of an AWAIT_ALL / AWAIT_ANY, at most 8 */
+	void _await_link(ICoroutine* subtasks[], uint8_t size);
+	/* run the live subtasks once and take the earliest wake(), false if none was live */
+	bool _await_run();
+	/*
+	 * index of the first ended subtask, which becomes the only one, the others are deleted. -1 if none.
+	 * A never allocated one is done at once: _subtask is left null and _subtask_lost set.
+	 */
+	int8_t _await_first();
+	/* subtask idx of the last AWAIT_ALL, nullptr if it was never allocated */
+	ICoroutine* _await_get(uint8_t idx);
+	/* HAS_TIMEOUT_OF(idx), true for a never allocated one */
+	bool _await_timeout(uint8_t idx);
 };
 
 #define COROUTINE(return_type, class_name, source) 									\
@@ -43,6 +162,12 @@ public: 																			\
 	class_name(unsigned long timeout_ms = TIMEOUT_MS) : ICoroutine(timeout_ms) {} 	\
 	return_type result() { return _result; } 										\
 	virtual void run(); 															\
+	static void* operator new(size_t size) noexcept {								\
+		static_assert(sizeof(class_name) <= CORO_POOL_BLOCK_SIZE,					\
+				"coroutine larger than CORO_POOL_BLOCK_SIZE");						\
+		return CoroPool::allocate(size);											\
+	}																				\
+	static void operator delete(void* block) { CoroPool::release(block); }			\
 private: 																			\
 	return_type _result;															\
 	source																			\
@@ -54,13 +179,28 @@ public: 																							\
 private: 																							\
 arg_type arg_name;
 
+/*
+ * new class_name, then its setters if a block was allocated, nullptr on an exhausted pool:
+ *   AWAIT(CORO_NEW(CountChar, set_from('A')->set_to('B')));
+ * The setters chained on new directly are only for a pool which can't be exhausted.
+ */
+#define CORO_NEW(class_name, ...) 		\
+[&]() -> class_name* { 					\
+	class_name* _coro = new class_name(); 	\
+	if (_coro != nullptr) 				\
+		_coro->__VA_ARGS__; 			\
+	return _coro; 						\
+}()
+
 #define CORO_VAR(var_type, var_name)	\
 private: 								\
 	var_type var_name;
 
 #define CORO_START(class_name)	 													\
 void class_name::run() { 															\
-	if (millis() - _start > _timeout_ms) { _has_timeout = true; _live = false; }	\
+	if (coro_expired(_start, _timeout_ms, coro_now())) {							\
+		_has_timeout = true; _live = false; 										\
+	}																				\
 	if (!_live) return; 															\
 	switch (_state) { 																\
 	case 0:;
@@ -75,16 +215,47 @@ void class_name::run() { 															\
 
 #define YIELD() { _state = __LINE__; return; case __LINE__:; }
 
+/* yield at least once, until coro_now() reaches deadline. The scheduler does not run the coroutine before */
+#define YIELD_UNTIL(deadline) { 				\
+	_wake = (deadline); 						\
+	do 											\
+		YIELD() 								\
+	while (coro_before(coro_now(), _wake));		\
+}
+
+#define SLEEP(ms) YIELD_UNTIL(coro_now() + (ms))
+
+/*
+ * yield until condition is true, it is only checked again once event is signaled (or on timeout).
+ * The count is read before the condition, so a signal in between is not lost.
+ */
+#define WAIT_READY(event, condition) { 			\
+	_event = &(event); 							\
+	_event_seen = _event->count(); 				\
+	while (!(condition)) { 						\
+		_wake = _start + _timeout_ms + 1; 		\
+		YIELD(); 								\
+		_event_seen = _event->count(); 			\
+	} 											\
+	_event = nullptr; 							\
+	_wake = coro_now(); 						\
+}
+
+/* a nullptr coro, from an exhausted pool, is done at once with HAS_TIMEOUT() true and a default RESULT() */
 #define AWAIT(coro) 						\
-if (_subtask != nullptr) delete _subtask; 	\
+_await_reset(); 							\
 _subtask = coro; 							\
-while (_subtask->live()) { 					\
+_subtask_lost = _subtask == nullptr; 		\
+while (_subtask != nullptr && _subtask->live()) { 	\
 	_subtask->run(); 						\
+	_wake = _subtask->wake(); 				\
 	YIELD(); 								\
 }
 
 #define RESULT(class_name) 								\
 [this](){												\
+	if (this->_subtask_lost)							\
+		return decltype(((class_name*) this->_subtask)->result())();	\
 	if (this->_subtask == nullptr)						\
 		return _result;									\
 	auto tmp = ((class_name*)this->_subtask)->result();	\
@@ -93,7 +264,48 @@ while (_subtask->live()) { 					\
 	return tmp;											\
 }()
 
-#define HAS_TIMEOUT() _subtask == nullptr ? false : _subtask->has_timeout()
+#define HAS_TIMEOUT() (_subtask == nullptr ? _subtask_lost : _subtask->has_timeout())
+
+/*
+ * AWAIT on up to 8 coroutines at once: they are all run on each run, so they wait together.
+ * AWAIT_ALL returns once all are done, RESULT_OF(idx, class_name) and HAS_TIMEOUT_OF(idx) give
+ * subtask idx, in the order of the arguments. They are deleted by the next AWAIT. A nullptr
+ * subtask has HAS_TIMEOUT_OF() true and a default constructed RESULT_OF().
+ */
+#define AWAIT_ALL(...) 														\
+{ 																			\
+	_await_reset(); 														\
+	ICoroutine* _all[] = {__VA_ARGS__}; 									\
+	static_assert(sizeof(_all) / sizeof(_all[0]) <= 8, "AWAIT_ALL of more than 8");	\
+	_await_link(_all, sizeof(_all) / sizeof(_all[0])); 						\
+} 																			\
+while (_await_run()) 														\
+	YIELD();
+
+#define RESULT_OF(idx, class_name) 										\
+[&](){ 																	\
+	class_name* _sub = (class_name*) this->_await_get(idx); 			\
+	return _sub == nullptr ? decltype(_sub->result())() : _sub->result(); 	\
+}()
+
+#define HAS_TIMEOUT_OF(idx) _await_timeout(idx)
+
+/*
+ * returns as soon as one is done, its index is stored in winner (an int8_t). The others are
+ * deleted, RESULT() and HAS_TIMEOUT() are those of the winner, a default constructed result and
+ * true for a nullptr one, which is done at once.
+ */
+#define AWAIT_ANY(winner, ...) 												\
+{ 																			\
+	_await_reset(); 														\
+	ICoroutine* _any[] = {__VA_ARGS__}; 									\
+	static_assert(sizeof(_any) / sizeof(_any[0]) <= 8, "AWAIT_ANY of more than 8");	\
+	_await_link(_any, sizeof(_any) / sizeof(_any[0])); 						\
+} 																			\
+while (((winner) = _await_first()) < 0) { 									\
+	_await_run(); 															\
+	YIELD(); 																\
+}
 
 
 //////////// EXAMPLE OF ASYNC Delay implementation ////////////
@@ -104,7 +316,31 @@ COROUTINE(int, Delay,) // NOTE the ', ' because there is no argument or variable
 // Implementation in the corresponding .cpp file //
 
 typedef void (*coro_callback)(uint8_t idx, const ICoroutine*);
-void schedule_coro(ICoroutine* coroutines[], uint8_t size, coro_callback clbk);
+
+/*
+ * run until all the coroutines are done, sleeping while none is due. Returns the number of
+ * nullptr slots it was given, which are skipped: left empty on purpose, or a coroutine which
+ * could not be allocated from an exhausted pool
+ */
+uint8_t schedule_coro(ICoroutine* coroutines[], uint8_t size, coro_callback clbk);
+
+/*
+ * Single pass: run the due coroutines only, call clbk then delete the finished ones.
+ * Returns the number of coroutines left and sets next_wake to the earliest wake() of them.
+ * The nullptr slots are skipped: a finished coroutine leaves one, and nothing tells it from
+ * a coroutine that could not be allocated.
+ */
+uint8_t schedule_coro_once(ICoroutine* coroutines[], uint8_t size, coro_callback clbk,
+		unsigned long* next_wake);
+
+/*
+ * block until millis() reaches deadline or a CoroEvent is signaled: condition variable on Linux,
+ * idle sleep on AVR
+ */
+void coro_sleep_until(unsigned long deadline);
+
+/* wake up coro_sleep_until, called by CoroEvent::signal */
+void coro_notify();
 
 
 #endif
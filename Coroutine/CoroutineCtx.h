@@ -2,6 +2,7 @@
 #define __COROUTINE__
 
 #include <Arduino.h>
+#include <CoroClock.h>
 
 #define TIMEOUT_MS 5 * 1000
 
@@ -10,10 +11,23 @@ struct CoroCtx {
 	bool _live;
 	int16_t _state;
 	bool _has_timeout;
+	bool _awaiting;  // inside AWAIT_CTX, a scheduler keeps it on the same thread
 	unsigned long _start;
 	unsigned long _timeout_ms;
+	CoroCtx* _timer_next;  // in a CoroTimerWheel slot
+	CoroCtx** _timer_pprev;  // nullptr when the coroutine checks its timeout itself
 };
 
+/* remove the timeout from its CoroTimerWheel in O(1), no-op if it is not in one */
+inline void coro_timer_cancel(CoroCtx& ctx) {
+	if (ctx._timer_pprev == nullptr)
+		return;
+	*ctx._timer_pprev = ctx._timer_next;
+	if (ctx._timer_next != nullptr)
+		ctx._timer_next->_timer_pprev = ctx._timer_pprev;
+	ctx._timer_pprev = nullptr;
+}
+
 #define CORO_CTX(return_type, fct_name, source)					\
 		struct fct_name ## _ctx : CoroCtx {						\
 			return_type _result;								\
@@ -26,31 +40,113 @@ struct CoroCtx {
 	ctx._live = true;				\
 	ctx._state = 0;					\
 	ctx._has_timeout = false;		\
-	ctx._start = millis();			\
+	ctx._start = coro_now();		\
 	ctx._timeout_ms = timeout_ms;
 
 #define CORO_BEGIN_CTX(fct_name)	 												\
 void fct_name(fct_name ## _ctx &ctx) { 															\
-	if (millis() - ctx._start > ctx._timeout_ms) { ctx._has_timeout = true; ctx._live = false; }	\
+	if (ctx._live && ctx._timer_pprev == nullptr											\
+			&& coro_expired(ctx._start, ctx._timeout_ms, coro_now())) {							\
+		ctx._has_timeout = true; ctx._live = false; 											\
+	}																							\
 	if (!ctx._live) return; 																	\
 	switch (ctx._state) { 																		\
 	case 0:;
 
-#define CORO_END_CTX()		\
-		ctx._live = false;	\
-	return; 				\
-	}						\
+#define CORO_END_CTX()				\
+		ctx._live = false;			\
+		coro_timer_cancel(ctx);		\
+	return; 						\
+	}								\
 }
 
 #define CORO_RETURN_CTX(result) ctx._result = result;
 
 #define YIELD_CTX() { ctx._state = __LINE__; return; case __LINE__:; }
 
-#define AWAIT_CTX(fct_name, ctx)		\
-		while(ctx._live) {				\
-			fct_name(ctx);				\
+#define AWAIT_CTX(fct_name, sub)		\
+		ctx._awaiting = true;			\
+		while(sub._live) {				\
+			fct_name(sub);				\
 			YIELD_CTX();				\
+		}								\
+		ctx._awaiting = false;
+
+/* a CoroCtx and the function running it, type erased */
+struct CoroTask {
+	CoroCtx* ctx;
+	void (*fct)(CoroCtx&);
+};
+
+template<typename Ctx, void (*Fct)(Ctx&)>
+void coro_task_run(CoroCtx& ctx) {
+	Fct(static_cast<Ctx&>(ctx));
+}
+
+#define CORO_TASK(fct_name, sub) CoroTask{&(sub), &coro_task_run<fct_name ## Ctx, fct_name>}
+
+/* run the live ones once, false if none was live */
+inline bool coro_await_all(CoroTask tasks[], uint8_t size) {
+	bool ran = false;
+	for (uint8_t i = 0; i < size; ++i) {
+		if (!tasks[i].ctx->_live)
+			continue;
+		tasks[i].fct(*tasks[i].ctx);
+		ran = true;
+	}
+	return ran;
+}
+
+/*
+ * index of the first ended one, the others are cancelled: not live anymore, timed out and
+ * out of their timer wheel. -1 if none ended, then the live ones are run once.
+ */
+inline int8_t coro_await_any(CoroTask tasks[], uint8_t size) {
+	for (uint8_t i = 0; i < size; ++i) {
+		if (tasks[i].ctx->_live)
+			continue;
+		for (uint8_t j = 0; j < size; ++j) {
+			CoroCtx& loser = *tasks[j].ctx;
+			if (!loser._live)
+				continue;
+			loser._live = false;
+			loser._has_timeout = true;
+			coro_timer_cancel(loser);
 		}
+		return i;
+	}
+	coro_await_all(tasks, size);
+	return -1;
+}
+
+/*
+ * AWAIT_CTX on several sub contexts at once, given as CORO_TASK(fct_name, sub): they are all run
+ * on each run, so they wait together. Their results stay in their contexts.
+ */
+#define AWAIT_ALL_CTX(...)													\
+		ctx._awaiting = true;												\
+		while (true) {														\
+			{																\
+				CoroTask _all[] = {__VA_ARGS__};							\
+				if (!coro_await_all(_all, sizeof(_all) / sizeof(_all[0])))	\
+					break;													\
+			}																\
+			YIELD_CTX();													\
+		}																	\
+		ctx._awaiting = false;
+
+/* returns as soon as one is done, its index is stored in winner (an int8_t), the others are cancelled */
+#define AWAIT_ANY_CTX(winner, ...)														\
+		ctx._awaiting = true;															\
+		while (true) {																	\
+			{																			\
+				CoroTask _any[] = {__VA_ARGS__};										\
+				if (((winner) = coro_await_any(_any, sizeof(_any) / sizeof(_any[0]))) >= 0)	\
+					break;																\
+			}																			\
+			YIELD_CTX();																\
+		}																				\
+		ctx._awaiting = false;
 
 //#define CORO_RESULT(ctx) (ctx._has_timeout ? reinterpret_cast<decltype(ctx._result)>(0) : ctx._result)
 #define CORO_RESULT(ctx) ctx._result
@@ -59,4 +155,301 @@ void fct_name(fct_name ## _ctx &ctx) { 															\
 
 #define CORO_ALIVE(ctx) ctx._live
 
+/*
+ * Timeouts of many coroutines, expired by the scheduler instead of each coroutine calling
+ * coro_now() on every run. Hierarchical: Levels of 2^Bits slots, level l holding the timeouts
+ * due in less than 2^(Bits * (l + 1)) ms, cascaded to the level below when their turn comes.
+ * Further timeouts wait in the last level and are cascaded again.
+ *
+ * add and cancel are O(1), advance costs the expiring timeouts plus one step per 2^Bits ms.
+ * A coroutine in a wheel must not be CORO_INIT again before it ends or times out.
+ * Not thread safe: the wheel, and the coroutines in it, belong to a single scheduler thread.
+ * make_coro_wheel_scheduler() gives a CoroStaticScheduler which owns and advances one.
+ */
+template<uint8_t Levels = 4, uint8_t Bits = 6>
+class CoroTimerWheel {
+public:
+	static_assert(Bits <= 6, "the pending slots of level 0 are a 64 bits mask");
+
+	CoroTimerWheel(unsigned long now = coro_now());
+
+	/* register the timeout of an initialized ctx */
+	void add(CoroCtx& ctx);
+
+	/* expire the timeouts up to now, returns how many */
+	uint32_t advance(unsigned long now = coro_now());
+
+	/* remove the timeout of ctx, no-op if it is not in a wheel */
+	static void cancel(CoroCtx& ctx);
+
+private:
+	static const uint16_t SLOTS = 1 << Bits;
+	static const uint16_t MASK = SLOTS - 1;
+
+	static unsigned long _expiry(const CoroCtx& ctx);
+	void _insert(CoroCtx& ctx, unsigned long expiry);
+	void _cascade(uint8_t level);
+
+	CoroCtx* _slots[Levels][SLOTS];
+	uint64_t _pending;  // level 0 slots which may be non-empty
+	unsigned long _now;  // the timeouts due up to _now have expired
+};
+
+#define CORO_INIT_WHEEL(ctx, timeout_ms, wheel)	\
+	CORO_INIT(ctx, timeout_ms);					\
+	(wheel).add(ctx);
+
+template<uint8_t Levels, uint8_t Bits>
+CoroTimerWheel<Levels, Bits>::CoroTimerWheel(unsigned long now) :
+		_pending(0), _now(now) {
+	memset(_slots, 0, sizeof(_slots));
+}
+
+template<uint8_t Levels, uint8_t Bits>
+void CoroTimerWheel<Levels, Bits>::add(CoroCtx& ctx) {
+	coro_timer_cancel(ctx);
+	unsigned long expiry = _expiry(ctx);
+	// already due: the slot of _now has been processed, expires on the next advance
+	_insert(ctx, coro_before(_now, expiry) ? expiry : _now + 1);
+}
+
+/* first time passing the check of CORO_BEGIN_CTX: coro_expired(_start, _timeout_ms, now) */
+template<uint8_t Levels, uint8_t Bits>
+unsigned long CoroTimerWheel<Levels, Bits>::_expiry(const CoroCtx& ctx) {
+	return ctx._start + ctx._timeout_ms + 1;
+}
+
+template<uint8_t Levels, uint8_t Bits>
+void CoroTimerWheel<Levels, Bits>::_insert(CoroCtx& ctx, unsigned long expiry) {
+	unsigned long delta = expiry - _now;
+	uint8_t level = 0;
+	while (level + 1 < Levels && delta >> (Bits * (level + 1)) != 0)
+		++level;
+	if ((unsigned) (Bits * (level + 1)) < sizeof(unsigned long) * 8 && delta >> (Bits * (level + 1)) != 0)
+		expiry = _now + ((1UL << (Bits * (level + 1))) - 1); // too far, cascaded again later
+	uint16_t idx = (expiry >> (Bits * level)) & MASK;
+	CoroCtx** head = &_slots[level][idx];
+	ctx._timer_next = *head;
+	if (*head != nullptr)
+		(*head)->_timer_pprev = &ctx._timer_next;
+	*head = &ctx;
+	ctx._timer_pprev = head;
+	if (level == 0)
+		_pending |= (uint64_t) 1 << idx;
+}
+
+template<uint8_t Levels, uint8_t Bits>
+void CoroTimerWheel<Levels, Bits>::_cascade(uint8_t level) {
+	CoroCtx* ctx = _slots[level][(_now >> (Bits * level)) & MASK];
+	_slots[level][(_now >> (Bits * level)) & MASK] = nullptr;
+	while (ctx != nullptr) {
+		CoroCtx* next = ctx->_timer_next;
+		unsigned long expiry = _expiry(*ctx);
+		// due now goes to the slot of _now, processed right after the cascades
+		_insert(*ctx, coro_before(expiry, _now) ? _now : expiry);
+		ctx = next;
+	}
+}
+
+template<uint8_t Levels, uint8_t Bits>
+void CoroTimerWheel<Levels, Bits>::cancel(CoroCtx& ctx) {
+	coro_timer_cancel(ctx);
+}
+
+template<uint8_t Levels, uint8_t Bits>
+uint32_t CoroTimerWheel<Levels, Bits>::advance(unsigned long now) {
+	uint32_t count = 0;
+	while (coro_before(_now, now)) {
+		// jump to the next level 0 slot with timeouts, or to the next cascade
+		uint16_t idx = (_now + 1) & MASK;
+		uint64_t pending = idx == 0 ? 0 : _pending >> idx;
+		unsigned long next = pending != 0 ? _now + 1 + __builtin_ctzll(pending) : (_now | MASK) + 1;
+		if (coro_before(now, next)) {
+			_now = now;
+			break;
+		}
+		_now = next;
+		for (uint8_t level = 1; level < Levels && ((_now >> (Bits * (level - 1))) & MASK) == 0; ++level)
+			_cascade(level);
+		idx = _now & MASK;
+		CoroCtx* ctx = _slots[0][idx];
+		_slots[0][idx] = nullptr;
+		_pending &= ~((uint64_t) 1 << idx);
+		while (ctx != nullptr) {
+			CoroCtx* next_ctx = ctx->_timer_next;
+			ctx->_timer_pprev = nullptr;
+			ctx->_has_timeout = true;
+			ctx->_live = false;
+			++count;
+			ctx = next_ctx;
+		}
+	}
+	return count;
+}
+
+/*
+ * Scheduler over a fixed set of contexts known at compile time: no heap, no vtable, and the
+ * coroutine functions are direct calls the compiler can inline in the pass.
+ *
+ *   auto scheduler = make_coro_scheduler(CORO_BIND(CountNumber, a), CORO_BIND(Delay, d));
+ *   scheduler.run(clbk);
+ *
+ * clbk(uint8_t idx, const Ctx& ctx) is called once when a coroutine ends or times out, with
+ * the real type of its context, so CORO_RESULT(ctx) needs no cast. It is a functor with one
+ * overload per context type, or a template operator().
+ *
+ * make_coro_wheel_scheduler() gives one owning a CoroTimerWheel: the live contexts are added
+ * to it on the first pass, and each pass advances it instead of each coroutine checking its
+ * timeout. Such a scheduler must not be copied once it ran.
+ */
+template<typename Ctx, void (*Fct)(Ctx&)>
+class CoroBind {
+public:
+	CoroBind(Ctx& ctx) :
+			_ctx(&ctx), _reported(false) {
+	}
+
+	/* runs it once if live, false once ended and reported */
+	template<typename Clbk>
+	bool run(uint8_t idx, Clbk& clbk);
+
+	Ctx& ctx() {
+		return *_ctx;
+	}
+
+private:
+	Ctx* _ctx;
+	bool _reported;
+};
+
+#define CORO_BIND(fct_name, ctx) CoroBind<fct_name ## _ctx, fct_name>(ctx)
+
+/* the Wheel of make_coro_scheduler(): none, each coroutine checks its own timeout */
+class CoroNoWheel {
+public:
+	CoroNoWheel(unsigned long = 0) {
+	}
+	void add(CoroCtx&) {
+	}
+	uint32_t advance(unsigned long) {
+		return 0;
+	}
+	static void cancel(CoroCtx&) {
+	}
+};
+
+/* the binds of a CoroStaticScheduler, unrolled at compile time */
+template<typename ... Binds>
+class _CoroBinds;
+
+template<>
+class _CoroBinds<> {
+public:
+	template<typename Clbk>
+	uint8_t run_once(Clbk&, uint8_t) {
+		return 0;
+	}
+	template<typename Wheel>
+	void add_to(Wheel&) {
+	}
+	template<typename Wheel>
+	void leave(Wheel&) {
+	}
+};
+
+template<typename Bind, typename ... Rest>
+class _CoroBinds<Bind, Rest...> {
+public:
+	_CoroBinds(Bind bind, Rest ... rest) :
+			_bind(bind), _rest(rest...) {
+	}
+
+	template<typename Clbk>
+	uint8_t run_once(Clbk& clbk, uint8_t idx) {
+		uint8_t live = _bind.run(idx, clbk) ? 1 : 0;
+		return live + _rest.run_once(clbk, idx + 1);
+	}
+
+	template<typename Wheel>
+	void add_to(Wheel& wheel) {
+		if (_bind.ctx()._live)
+			wheel.add(_bind.ctx());
+		_rest.add_to(wheel);
+	}
+
+	template<typename Wheel>
+	void leave(Wheel& wheel) {
+		wheel.cancel(_bind.ctx());
+		_rest.leave(wheel);
+	}
+
+private:
+	Bind _bind;
+	_CoroBinds<Rest...> _rest;
+};
+
+template<typename Wheel, typename ... Binds>
+class CoroStaticScheduler {
+public:
+	CoroStaticScheduler(Binds ... binds) :
+			_binds(binds...), _armed(false) {
+	}
+
+	/* the contexts still in the wheel leave it */
+	~CoroStaticScheduler() {
+		if (_armed)
+			_binds.leave(_wheel);
+	}
+
+	/* one pass over all the coroutines, returns how many are still live */
+	template<typename Clbk>
+	uint8_t run_once(Clbk&& clbk) {
+		CoroPass pass;
+		if (!_armed) {
+			_wheel = Wheel(coro_now());
+			_binds.add_to(_wheel);
+			_armed = true;
+		}
+		_wheel.advance(coro_now());
+		return _binds.run_once(clbk, 0);
+	}
+
+	/* returns when they are all done */
+	template<typename Clbk>
+	void run(Clbk&& clbk) {
+		while (run_once(clbk) != 0)
+			;
+	}
+
+private:
+	_CoroBinds<Binds...> _binds;
+	Wheel _wheel;
+	bool _armed;  // the contexts were added to _wheel
+};
+
+template<typename ... Binds>
+CoroStaticScheduler<CoroNoWheel, Binds...> make_coro_scheduler(Binds ... binds) {
+	return CoroStaticScheduler<CoroNoWheel, Binds...>(binds...);
+}
+
+template<typename Wheel = CoroTimerWheel<>, typename ... Binds>
+CoroStaticScheduler<Wheel, Binds...> make_coro_wheel_scheduler(Binds ... binds) {
+	return CoroStaticScheduler<Wheel, Binds...>(binds...);
+}
+
+template<typename Ctx, void (*Fct)(Ctx&)>
+template<typename Clbk>
+bool CoroBind<Ctx, Fct>::run(uint8_t idx, Clbk& clbk) {
+	if (_ctx->_live) {
+		Fct(*_ctx);
+		if (_ctx->_live)
+			return true;
+	}
+	if (_reported)
+		return false;
+	_reported = true;
+	clbk(idx, (const Ctx&) *_ctx);
+	return false;
+}
+
 #endif
@@ -2,6 +2,25 @@
 #define __ATCMD_H__
 
 #include <Arduino.h>
+#include <TokenMatcher.h>
+#include <AtFormat.h>
+
+/*
+ * Final result codes and events, all searched in a single pass over the buffer.
+ * Keep at_token in the same order.
+ */
+TOKEN_TABLE(AtTokens, "OK\r\n", "ERROR\r\n", "+CFUN:", "+CPIN:", "+DTMF:")
+
+enum at_token
+	: uint8_t {
+	AT_TOKEN_OK = 0,
+	AT_TOKEN_ERROR,
+	AT_TOKEN_CFUN,
+	AT_TOKEN_CPIN,
+	AT_TOKEN_DTMF
+};
+
+typedef TokenMatcher<AtTokens> AtMatcher;
 
 //#ifndef AT_TIMEOUT_MS
 //#define AT_TIMEOUT_MS 500
@@ -13,7 +32,6 @@
 //enum at_cmd_result
 //	: int8_t {
 //	ERROR_EXEC_ALREADY_RUNNING = 0, // from here: errors
-//	ERROR_EXEC_INTERNAL_BUFFER_TOO_SMALL, // error while generating cmd
 //	ERROR_EXEC_WRITING, // serial write failed
 //	ERROR_EXEC_TIMEOUT, // timeout
 //	EXEC_PENDING = 10, // waiting for more data
@@ -44,44 +62,19 @@
 //	typedef StringBuffer<BUFFER_SIZE> Buffer;
 //
 //	/**
-//	 * send a command on the serial port
-//	 * \param[in] format string format like printf
+//	 * send a command on the serial port, formatted on the fly by at_format without intermediate buffer
+//	 * \param[in] format string format, %d %i %u %s %c %% only
 //	 * \param[in] ... arguments if needed by format
 //	 * \retval EXEC_PENDING the command was successfully send and waiting for answer
 //	 * \retval ERROR_EXEC_ALREADY_RUNNING a command is already in execution
-//	 * \retval ERROR_EXEC_INTERNAL_BUFFER_TOO_SMALL the evaluation of format string is too large. Internal buffer is limited to 256
-//	 * \retval ERROR_EXEC_WRITING the number of byte returned by write do not match the length of its input buffer
+//	 * \retval ERROR_EXEC_WRITING the serial port did not accept the whole command
 //	 */
-////	enum at_cmd_result exec(const char* format, ...) {
-////		if (_is_executing)
-////			return ERROR_EXEC_ALREADY_RUNNING;
-////		buffer.clear();
-////		const size_t buff_len = 255;
-////		va_list ap_check, ap;
-////		va_start(ap_check, format);
-////		va_copy(ap, ap_check);
-////		size_t len = vsnprintf(NULL, 0, format, ap_check);
-////		if (len > buff_len) {
-////			va_end(ap_check);
-////			va_end(ap);
-////			return ERROR_EXEC_INTERNAL_BUFFER_TOO_SMALL;
-////		}
-////		char buff[buff_len];
-////		vsnprintf(buff, buff_len, format, ap);
-////		va_end(ap_check);
-////		va_end(ap);
-////		if (_serial.write(buff, len) == len) {
-////			_exec_start = millis();
-////			_is_executing = true;
-////			return EXEC_PENDING;
-////		}
-////		return ERROR_EXEC_WRITING;
-////	}
-//	enum at_cmd_result exec(const char* msg, size_t len) {
+//	template<typename ... Args>
+//	enum at_cmd_result exec(const char* format, Args ... args) {
 //		if (_is_executing)
 //			return ERROR_EXEC_ALREADY_RUNNING;
 //		buffer.clear();
-//		if (_serial.write(msg, len) == len) {
+//		if (at_format(_serial, format, args...) == at_length(format, args...)) {
 //			_exec_start = millis();
 //			_is_executing = true;
 //			return EXEC_PENDING;
@@ -108,11 +101,10 @@
 //			buffer.append(_serial.read());
 //		}
 //		enum at_cmd_result result = is_event_available();
-//		if (result != NO_EVENT)
-//			return result;
-//		result = is_execution_done();
-//		if (result != EXEC_PENDING)
+//		if (result == EXEC_OK || result == EXEC_ERROR)
 //			_is_executing = false;
+//		if (result == NO_EVENT)
+//			return EXEC_PENDING;
 //		return result;
 //	}
 //
@@ -123,66 +115,35 @@
 //	bool _is_executing; // set to on when calling exec() && !_is_executing, set to false when timeout or 'or' or 'error'
 //	unsigned long _exec_start; // initialized when a new command is executed
 //
-//	enum at_cmd_result is_execution_done() {
-//		auto pos = buffer.index_of("OK\r\n");
-//		if (pos != StringBuffer<BUFFER_SIZE>::END) {
+//	/*
+//	 * single pass over the buffer for both the events and the end of the command
+//	 */
+//	enum at_cmd_result is_event_available() {
+//		uint16_t tok;
+//		uint8_t token = AtMatcher::find(buffer, &tok);
+//		if (token == AtMatcher::NONE)
+//			return NO_EVENT;
+//		if (token == AT_TOKEN_OK)
 //			return EXEC_OK;
-//		}
-//		pos = buffer.index_of("ERROR\r\n");
-//		if (pos != StringBuffer<BUFFER_SIZE>::END) {
+//		if (token == AT_TOKEN_ERROR)
 //			return EXEC_ERROR;
+//		uint16_t newline = buffer.index_of("\r\n", tok); // find new line
+//		if (newline == StringBuffer<BUFFER_SIZE>::END) {
+//			return EXEC_PENDING;
 //		}
-//		return EXEC_PENDING;
-//	}
-//
-//	enum at_cmd_result is_event_available() {
-//		for (auto event: at_events) {
-//			uint16_t tok = buffer.index_of(event.token);
-//			if (tok == StringBuffer<BUFFER_SIZE>::END) {
-//				continue;
-//			}
-//			uint16_t newline = buffer.index_of("\r\n", tok); // find new line
-//			if (newline == StringBuffer<BUFFER_SIZE>::END) {
-//				return EXEC_PENDING;;
-//			}
-//			return event.type;
-//		}
-//		return NO_EVENT;
+//		return (enum at_cmd_result) (EVT_CFUN + token - AT_TOKEN_CFUN);
 //	}
-//
-//	/*
-//	 * EVENTS
-//	 */
-//
-//	struct _at_event {
-//		const char* token;
-//		enum at_cmd_result type;
-//	};
-//
-//	static constexpr struct _at_event at_events[] = {
-//			{AT_CFUN::EVT, EVT_CFUN},
-//			{AT_CPIN::EVT, EVT_CPIN},
-//			{AT_DTMF::EVT, EVT_DTMF},
-//
-//	//		{"+CGREG:", AT_CGREG},
-//	//		{"+CLCC:", AT_CLCC},
-//	//		{"+CMGF:", AT_CMGF},
-//	//		{"+CMGL:", AT_CMGL},
-//	//		{"+CME ERROR:", AT_DTMF},
-//	};
 //};
 //
-//template<typename T, uint16_t BUFFER_SIZE>
-//constexpr struct ATCmd<T, BUFFER_SIZE>::_at_event ATCmd<T, BUFFER_SIZE>::at_events[];
-//
 //
 ///*
 // * AT_OK
 // */
 //
 //namespace AT_OK {
-//size_t test(char* buff, size_t len) {
-//	return snprintf(buff, len, "\r\n\r\nAT\r\n");
+//template<typename Sink>
+//size_t test(Sink& sink) {
+//	return at_format(sink, "\r\n\r\nAT\r\n");
 //}
 //}
 //
@@ -196,8 +157,9 @@
 //	ON = 1,
 //};
 //
-//size_t write(char* buff, size_t len, enum AT_ECHO::status status) {
-//return snprintf(buff, len, "ATE%d\r\n", status);
+//template<typename Sink>
+//size_t write(Sink& sink, enum AT_ECHO::status status) {
+//return at_format(sink, "ATE%d\r\n", status);
 //}
 //}
 #endif
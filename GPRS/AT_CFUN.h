@@ -2,6 +2,7 @@
 #define __AT_CFUN_H__
 
 #include <Arduino.h>
+#include <AtFormat.h>
 
 namespace AT_CFUN {
 
@@ -18,35 +19,35 @@ enum rst : int8_t {
 
 static constexpr char* EVT = F("+CFUN:");
 
-size_t test(char* buff, size_t len) {
-	return snprintf(buff, len, "AT+CFUN=?\r\n");
+template<typename Sink>
+size_t test(Sink& sink) {
+	return at_format(sink, "AT+CFUN=?\r\n");
 }
 
-size_t read(char* buff, size_t len) {
-	return snprintf(buff, len, "AT+CFUN?\r\n");
+template<typename Sink>
+size_t read(Sink& sink) {
+	return at_format(sink, "AT+CFUN?\r\n");
 }
 
-size_t write(char* buff, size_t len, enum AT_CFUN::fun fun, enum AT_CFUN::rst rst = NO_RESET) {
-	return snprintf(buff, len, "AT+CFUN=%d,%d\r\n", fun, rst);
+template<typename Sink>
+size_t write(Sink& sink, enum AT_CFUN::fun fun, enum AT_CFUN::rst rst = NO_RESET) {
+	return at_format(sink, "AT+CFUN=%d,%d\r\n", fun, rst);
 }
 
-template<uint16_t BUFFER_SIZE = 0>
-uint8_t parse(StringBuffer<BUFFER_SIZE>& buffer, enum AT_CFUN::fun* fun) {
-	buffer.pop_until(EVT);
-	buffer.pop_while(' ');
+template<typename Buffer>
+uint8_t parse(Buffer& buffer, enum AT_CFUN::fun* fun) {
+	typename Buffer::Line line;
+	if (!buffer.find_line(EVT, &line))
+		return 0;
+	uint32_t value;
 	uint8_t count = 0;
 
-	if (buffer[0] == '0') {
-		*fun = MINIMAL;
-		++count;
-	} else if (buffer[0] == '1') {
-		*fun = FULL;
-		++count;
-	} else if (buffer[0] == '4') {
-		*fun = DISABLE;
+	if (line.substr(strlen(EVT)).trim_left(' ').parse_uint(&value)
+			&& (value == MINIMAL || value == FULL || value == DISABLE)) {
+		*fun = (enum AT_CFUN::fun) value;
 		++count;
 	}
-	buffer.pop_until(F("\r\n"));
+	buffer.consume(line);
 	return count;
 }
 }
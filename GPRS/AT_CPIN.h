@@ -2,6 +2,7 @@
 #define __AT_CPIN_H__
 
 #include <Arduino.h>
+#include <AtFormat.h>
 
 namespace AT_CPIN {
 
@@ -52,31 +53,35 @@ COROUTINE(bool, AtCpinTest,
 //CORO_RETURN(0);
 //CORO_END();
 
-size_t read(char* buff, size_t len) {
-	return snprintf(buff, len, "AT+CPIN?\r\n");
+template<typename Sink>
+size_t read(Sink& sink) {
+	return at_format(sink, "AT+CPIN?\r\n");
 }
 
-size_t write(char* buff, size_t len, const char* pin) {
-	return snprintf(buff, len, "AT+CPIN=%s\r\n", pin);
+template<typename Sink>
+size_t write(Sink& sink, const char* pin) {
+	return at_format(sink, "AT+CPIN=%s\r\n", pin);
 }
 
-template<uint16_t BUFFER_SIZE = 0>
-uint8_t parse(StringBuffer<BUFFER_SIZE>& buffer, enum AT_CPIN::status* status) {
-	buffer.pop_until(EVT);
-	buffer.pop_while(' ');
+template<typename Buffer>
+uint8_t parse(Buffer& buffer, enum AT_CPIN::status* status) {
+	typename Buffer::Line line;
+	if (!buffer.find_line(EVT, &line))
+		return 0;
+	typename Buffer::Line value = line.substr(strlen(EVT)).trim_left(' ');
 	uint8_t count = 0;
 
-	if (buffer.starts_with(F("READY"))) {
+	if (value.starts_with(F("READY"))) {
 		*status = READY;
 		++count;
-	} else if (buffer.starts_with(F("SIM PIN"))) {
+	} else if (value.starts_with(F("SIM PIN"))) {
 		*status = SIM_PIN;
 		++count;
-	} else if (buffer.starts_with(F("SIM PUK"))) {
+	} else if (value.starts_with(F("SIM PUK"))) {
 		*status = SIM_PUK;
 		++count;
 	}
-	buffer.pop_until(F("\r\n"));
+	buffer.consume(line);
 	return count;
 }
 }
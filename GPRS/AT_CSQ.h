@@ -0,0 +1,46 @@
+#ifndef __AT_CSQ_H__
+#define __AT_CSQ_H__
+
+#include <Arduino.h>
+#include <AtFormat.h>
+
+namespace AT_CSQ {
+
+enum rssi : uint8_t {
+	UNKNOWN = 99 // not known or not detectable, for both rssi and ber
+};
+
+static constexpr char* EVT = F("+CSQ:");
+
+template<typename Sink>
+size_t exec(Sink& sink) {
+	return at_format(sink, "AT+CSQ\r\n");
+}
+
+/* ber is 0..7 or UNKNOWN, rssi up to UNKNOWN */
+static constexpr uint8_t BER_MAX = 7;
+
+/* +CSQ: <rssi>,<ber>, a value out of range is left untouched and not counted */
+template<typename Buffer>
+uint8_t parse(Buffer& buffer, uint8_t* rssi, uint8_t* ber) {
+	typename Buffer::Line line;
+	if (!buffer.find_line(EVT, &line))
+		return 0;
+	typename Buffer::Line value = line.substr(strlen(EVT)).trim_left(' ');
+	uint32_t number;
+	uint8_t count = 0;
+
+	if (value.field(0).parse_uint(&number) && number <= UNKNOWN) {
+		*rssi = number;
+		++count;
+	}
+	if (value.field(1).parse_uint(&number) && (number <= BER_MAX || number == UNKNOWN)) {
+		*ber = number;
+		++count;
+	}
+	buffer.consume(line);
+	return count;
+}
+}
+
+#endif
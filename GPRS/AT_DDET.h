@@ -2,6 +2,7 @@
 #define __AT_DDET_H__
 
 #include <Arduino.h>
+#include <AtFormat.h>
 
 namespace AT_DTMF {
 enum status : int8_t {
@@ -9,18 +10,25 @@ enum status : int8_t {
 	ENABLE = 1,
 };
 
-size_t write(char* buff, size_t len, enum AT_DTMF::status status) {
-return snprintf(buff, len, "AT+DDET=%d\r\n", status);
+template<typename Sink>
+size_t write(Sink& sink, enum AT_DTMF::status status) {
+return at_format(sink, "AT+DDET=%d\r\n", status);
 }
 
 static constexpr char* EVT = F("+DTMF:");
 
-template<uint16_t BUFFER_SIZE = 0>
-static uint8_t parse(StringBuffer<BUFFER_SIZE>& buffer, char* tone) {
-buffer.pop_until(EVT);
-buffer.pop_while(' ');
-*tone = buffer.pop_first();
-buffer.pop_until(F("\r\n"));
+template<typename Buffer>
+static uint8_t parse(Buffer& buffer, char* tone) {
+typename Buffer::Line line;
+if (!buffer.find_line(EVT, &line))
+	return 0;
+typename Buffer::Line value = line.substr(strlen(EVT)).trim_left(' ');
+if (value.empty()) {
+	buffer.consume(line);
+	return 0;
+}
+*tone = value[0];
+buffer.consume(line);
 return 1;
 }
 }
@@ -0,0 +1,165 @@
+#ifndef __AT_FORMAT_H__
+#define __AT_FORMAT_H__
+
+#include <Arduino.h>
+#include <string.h>
+
+/*
+ * DECLARATION
+ */
+
+/*
+ * Streaming formatter for the AT commands: the literals and the arguments are written piece
+ * by piece to the sink, without intermediate buffer nor printf.
+ *
+ * Directives: %d %i %u for integers, %s for strings, %c for a character and %% for '%'.
+ * The argument type selects the conversion, the directive only marks the place, except %c
+ * which writes an integer argument as a character.
+ *
+ * A sink is anything with size_t write(const char* data, size_t len), like a serial port.
+ * at_format returns the number of bytes accepted by the sink.
+ */
+template<typename Sink>
+size_t at_format(Sink& sink, const char* format);
+
+template<typename Sink, typename T, typename ... Args>
+size_t at_format(Sink& sink, const char* format, T value, Args ... args);
+
+/* length of the formatted command, nothing is written */
+template<typename ... Args>
+size_t at_length(const char* format, Args ... args);
+
+/*
+ * Append the command to a ring buffer used as TX queue, whole or not at all: returns 0 and
+ * leaves the queue untouched if there is not enough room.
+ */
+template<typename Ring, typename ... Args>
+size_t at_queue(Ring& ring, const char* format, Args ... args);
+
+/* sink appending to a ring buffer of char */
+template<typename Ring>
+class AtRingSink {
+public:
+	AtRingSink(Ring& ring) :
+			_ring(ring) {
+	}
+	size_t write(const char* data, size_t len) {
+		return _ring.append(data, len);
+	}
+private:
+	Ring& _ring;
+};
+
+/* sink counting the bytes */
+class AtCounter {
+public:
+	size_t write(const char*, size_t len) {
+		return len;
+	}
+};
+
+/*
+ * IMPLEMENTATION
+ */
+
+/* write the literal up to the next directive, *format is left on the directive character */
+template<typename Sink>
+size_t _at_literal(Sink& sink, const char** format) {
+	size_t written = 0;
+	const char* start = *format;
+	const char* c = start;
+	while (true) {
+		while (*c != '\0' && *c != '%')
+			++c;
+		if (c != start)
+			written += sink.write(start, c - start);
+		if (*c == '\0' || c[1] != '%')
+			break;
+		start = ++c; // "%%", the second '%' starts the next literal
+		++c;
+	}
+	*format = *c == '\0' ? c : c + 1;
+	return written;
+}
+
+template<typename Sink>
+size_t _at_put(Sink& sink, char directive, unsigned long value) {
+	char c = value;
+	if (directive == 'c')
+		return sink.write(&c, 1);
+	char digits[sizeof(unsigned long) * 3];
+	uint8_t i = sizeof(digits);
+	do {
+		digits[--i] = '0' + value % 10;
+		value /= 10;
+	} while (value != 0);
+	return sink.write(digits + i, sizeof(digits) - i);
+}
+
+template<typename Sink>
+size_t _at_put(Sink& sink, char directive, long value) {
+	if (value >= 0 || directive == 'c')
+		return _at_put(sink, directive, (unsigned long) value);
+	char minus = '-';
+	size_t written = sink.write(&minus, 1);
+	return written + _at_put(sink, directive, 0UL - (unsigned long) value);
+}
+
+template<typename Sink>
+size_t _at_put(Sink& sink, char directive, unsigned int value) {
+	return _at_put(sink, directive, (unsigned long) value);
+}
+
+/* also the enums and the smaller integers, by promotion */
+template<typename Sink>
+size_t _at_put(Sink& sink, char directive, int value) {
+	return _at_put(sink, directive, (long) value);
+}
+
+template<typename Sink>
+size_t _at_put(Sink& sink, char directive, char value) {
+	if (directive == 'c')
+		return sink.write(&value, 1);
+	return _at_put(sink, directive, (int) value);
+}
+
+template<typename Sink>
+size_t _at_put(Sink& sink, char, const char* value) {
+	return sink.write(value, strlen(value));
+}
+
+template<typename Sink>
+size_t at_format(Sink& sink, const char* format) {
+	size_t written = 0;
+	while (*format != '\0') {
+		written += _at_literal(sink, &format);
+		if (*format != '\0')
+			++format; // no argument left for this directive, skipped
+	}
+	return written;
+}
+
+template<typename Sink, typename T, typename ... Args>
+size_t at_format(Sink& sink, const char* format, T value, Args ... args) {
+	size_t written = _at_literal(sink, &format);
+	if (*format == '\0')
+		return written; // more arguments than directives
+	written += _at_put(sink, *format, value);
+	return written + at_format(sink, format + 1, args...);
+}
+
+template<typename ... Args>
+size_t at_length(const char* format, Args ... args) {
+	AtCounter counter;
+	return at_format(counter, format, args...);
+}
+
+template<typename Ring, typename ... Args>
+size_t at_queue(Ring& ring, const char* format, Args ... args) {
+	if (at_length(format, args...) > (size_t) (ring.capacity() - ring.length()))
+		return 0;
+	AtRingSink<Ring> sink(ring);
+	return at_format(sink, format, args...);
+}
+
+#endif
@@ -0,0 +1,375 @@
+#ifndef __MIRRORED_RING_BUFFER_H__
+#define __MIRRORED_RING_BUFFER_H__
+
+#ifndef __linux__
+#error "MirroredRingBuffer is only available on the Linux host build"
+#endif
+
+#include <string.h>
+#include <type_traits>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <Arduino.h>
+#include <RingBuffer.h>
+
+/*
+ * DECLARATION
+ */
+
+/*
+ * Host only RingBuffer backend for large buffers.
+ * The same pages are mapped twice, back-to-back, so that the content is always
+ * continuous in memory: buffer() never rotates anything and every bulk copy is a
+ * single memcpy.
+ * It exposes the same interface as RingBuffer<Size, T>, with 32 bits lengths.
+ *
+ * Size * sizeof(T) must be a multiple of the page size. If the mapping fails,
+ * valid() returns false and the buffer behaves as full and empty.
+ */
+template<uint32_t Size, typename T>
+class MirroredRingBuffer {
+
+	static_assert((Size * sizeof (T)) % 4096 == 0, "Size * sizeof(T) must be a multiple of the page size");
+	static_assert(std::is_trivially_copyable<T>::value, "T is accessed through two mappings");
+
+public:
+
+	typedef uint32_t size_type;
+
+	MirroredRingBuffer();
+
+	~MirroredRingBuffer();
+
+	bool valid() const;
+
+	uint32_t append(T c);
+
+	uint32_t append(const T* src, uint32_t n);
+
+	uint32_t read(T* dst, uint32_t n);
+
+	uint32_t discard(uint32_t n);
+
+	bool full() const;
+
+	bool empty() const;
+
+	void clear();
+
+	uint32_t length() const;
+
+	static uint32_t capacity();
+
+	const T operator[](uint32_t idx) const;
+
+	T pop_first();
+
+	uint32_t pop_firsts(uint32_t n);
+
+	T pop_last();
+
+	struct Segment {
+		const T* data;
+		uint32_t length;
+	};
+
+	/* second.length is always 0 */
+	struct Segments {
+		Segment first;
+		Segment second;
+	};
+
+	Segments segments() const;
+
+	/* always continuous, never modifies the buffer */
+	const T* buffer() const;
+
+	static const uint32_t END = -1;
+
+protected:
+
+	T* _buffer; // Size elements, mapped a second time right after
+	uint32_t _start; // in [0, Size)
+	uint32_t _length;
+
+private:
+
+	MirroredRingBuffer(const MirroredRingBuffer&);
+	MirroredRingBuffer& operator=(const MirroredRingBuffer&);
+};
+
+template<uint32_t Size, typename T>
+const uint32_t MirroredRingBuffer<Size, T>::END;
+
+
+template<uint32_t Size>
+class MirroredStringBuffer: public MirroredRingBuffer<Size, char> {
+
+public:
+
+	typedef RingStringView<uint32_t> Line;
+
+	using MirroredRingBuffer<Size, char>::END;
+	using MirroredRingBuffer<Size, char>::append;
+
+	uint32_t append(const char* str);
+
+	uint32_t index_of(const char* substr, uint32_t offset = 0);
+
+	bool starts_with(const char* substr);
+
+	bool pop_until(const char* substr);
+
+	bool pop_while(const char subchr);
+
+	bool next_line(Line* line, uint32_t offset = 0);
+
+	bool find_line(const char* prefix, Line* line, uint32_t offset = 0);
+
+	void consume(const Line& line);
+
+	Line view(uint32_t offset = 0, uint32_t length = END) const;
+
+};
+
+/*
+ * IMPLEMENTATION
+ */
+
+template<uint32_t Size, typename T>
+MirroredRingBuffer<Size, T>::MirroredRingBuffer() :
+		_buffer(nullptr), _start(0), _length(0) {
+	const size_t bytes = Size * sizeof (T);
+	if (bytes % sysconf(_SC_PAGESIZE) != 0)
+		return;
+	int fd = memfd_create("MirroredRingBuffer", MFD_CLOEXEC);
+	if (fd == -1)
+		return;
+	/* reserve the address range for both mappings, then map the file twice over it */
+	void* addr = MAP_FAILED;
+	if (ftruncate(fd, bytes) == 0)
+		addr = mmap(nullptr, 2 * bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (addr != MAP_FAILED) {
+		char* base = (char*) addr;
+		bool mapped = mmap(base, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == base;
+		mapped = mapped && mmap(base + bytes, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == base + bytes;
+		if (mapped)
+			_buffer = (T*) addr;
+		else
+			munmap(addr, 2 * bytes);
+	}
+	close(fd);
+}
+
+template<uint32_t Size, typename T>
+MirroredRingBuffer<Size, T>::~MirroredRingBuffer() {
+	if (_buffer != nullptr)
+		munmap(_buffer, 2 * Size * sizeof (T));
+}
+
+template<uint32_t Size, typename T>
+bool MirroredRingBuffer<Size, T>::valid() const {
+	return _buffer != nullptr;
+}
+
+template<uint32_t Size, typename T>
+uint32_t MirroredRingBuffer<Size, T>::append(T c) {
+	if (full())
+		return 0;
+	_buffer[_start + _length] = c; // may land in the mirror, that's the point
+	++_length;
+	return 1;
+}
+
+template<uint32_t Size, typename T>
+uint32_t MirroredRingBuffer<Size, T>::append(const T* src, uint32_t n) {
+	if (!valid())
+		return 0;
+	uint32_t count = capacity() - length();
+	if (n < count)
+		count = n;
+	memcpy(_buffer + _start + _length, src, count * sizeof (T));
+	_length += count;
+	return count;
+}
+
+template<uint32_t Size, typename T>
+uint32_t MirroredRingBuffer<Size, T>::read(T* dst, uint32_t n) {
+	uint32_t count = length();
+	if (n < count)
+		count = n;
+	memcpy(dst, _buffer + _start, count * sizeof (T));
+	return discard(count);
+}
+
+template<uint32_t Size, typename T>
+uint32_t MirroredRingBuffer<Size, T>::discard(uint32_t n) {
+	if (n > length())
+		n = length();
+	_start += n;
+	if (_start >= capacity())
+		_start -= capacity();
+	_length -= n;
+	return n;
+}
+
+template<uint32_t Size, typename T>
+bool MirroredRingBuffer<Size, T>::full() const {
+	return !valid() || capacity() == length();
+}
+
+template<uint32_t Size, typename T>
+bool MirroredRingBuffer<Size, T>::empty() const {
+	return length() == 0;
+}
+
+template<uint32_t Size, typename T>
+void MirroredRingBuffer<Size, T>::clear() {
+	_start = 0;
+	_length = 0;
+}
+
+template<uint32_t Size, typename T>
+uint32_t MirroredRingBuffer<Size, T>::length() const {
+	return _length;
+}
+
+template<uint32_t Size, typename T>
+uint32_t MirroredRingBuffer<Size, T>::capacity() {
+	return Size;
+}
+
+template<uint32_t Size, typename T>
+const T MirroredRingBuffer<Size, T>::operator[](uint32_t idx) const {
+	if (idx >= length())
+		return T(); // declared as undefined behavior for the user
+	return _buffer[_start + idx];
+}
+
+template<uint32_t Size, typename T>
+T MirroredRingBuffer<Size, T>::pop_first() {
+	if (empty())
+		return T();
+	T c = _buffer[_start];
+	discard(1);
+	return c;
+}
+
+template<uint32_t Size, typename T>
+uint32_t MirroredRingBuffer<Size, T>::pop_firsts(uint32_t n) {
+	return discard(n);
+}
+
+template<uint32_t Size, typename T>
+T MirroredRingBuffer<Size, T>::pop_last() {
+	if (empty())
+		return T();
+	--_length;
+	return _buffer[_start + _length];
+}
+
+template<uint32_t Size, typename T>
+typename MirroredRingBuffer<Size, T>::Segments MirroredRingBuffer<Size, T>::segments() const {
+	Segments segs = { { buffer(), length() }, { buffer(), 0 } };
+	return segs;
+}
+
+template<uint32_t Size, typename T>
+const T* MirroredRingBuffer<Size, T>::buffer() const {
+	return _buffer + _start;
+}
+
+template<uint32_t Size>
+uint32_t MirroredStringBuffer<Size>::append(const char* str) {
+	size_t str_length = strlen(str);
+	if (str_length > Size)
+		str_length = Size;
+	return this->append(str, str_length);
+}
+
+template<uint32_t Size>
+uint32_t MirroredStringBuffer<Size>::index_of(const char* substr, uint32_t offset) {
+	if (this->empty())
+		return END;
+	size_t substr_length = strlen(substr);
+	if (substr_length + offset > this->length())
+		return END;
+	const char* haystack = this->buffer();
+	const char* found = (const char*) memmem(haystack + offset, this->length() - offset, substr, substr_length);
+	if (found == nullptr)
+		return END;
+	return found - haystack;
+}
+
+template<uint32_t Size>
+bool MirroredStringBuffer<Size>::starts_with(const char* substr) {
+	size_t substr_length = strlen(substr);
+	if (this->empty() || substr_length > this->length())
+		return false;
+	return memcmp(this->buffer(), substr, substr_length) == 0;
+}
+
+template<uint32_t Size>
+bool MirroredStringBuffer<Size>::pop_until(const char* substr) {
+	uint32_t offset = index_of(substr);
+	if (offset == END)
+		return false;
+	this->pop_firsts(offset + strlen(substr));
+	return true;
+}
+
+template<uint32_t Size>
+bool MirroredStringBuffer<Size>::pop_while(const char subchr) {
+	if (this->empty() || (*this)[0] != subchr)
+		return false;
+	const char* data = this->buffer();
+	uint32_t count = 1;
+	while (count < this->length() && data[count] == subchr)
+		++count;
+	this->pop_firsts(count);
+	return true;
+}
+
+template<uint32_t Size>
+bool MirroredStringBuffer<Size>::next_line(Line* line, uint32_t offset) {
+	uint32_t length = this->length();
+	if (offset >= length)
+		return false;
+	const char* data = this->buffer();
+	const char* from = data + offset + 1;
+	const char* last = data + length;
+	while (from < last) {
+		const char* found = (const char*) memchr(from, '\n', last - from);
+		if (found == nullptr)
+			return false;
+		if (found[-1] == '\r') {
+			*line = Line(data, length, data, offset, found - 1 - data - offset);
+			return true;
+		}
+		from = found + 1;
+	}
+	return false;
+}
+
+template<uint32_t Size>
+bool MirroredStringBuffer<Size>::find_line(const char* prefix, Line* line, uint32_t offset) {
+	while (next_line(line, offset)) {
+		if (line->starts_with(prefix))
+			return true;
+		offset = line->offset() + line->length() + 2;
+	}
+	return false;
+}
+
+template<uint32_t Size>
+void MirroredStringBuffer<Size>::consume(const Line& line) {
+	this->pop_firsts(line.offset() + line.length() + 2);
+}
+
+template<uint32_t Size>
+typename MirroredStringBuffer<Size>::Line MirroredStringBuffer<Size>::view(uint32_t offset, uint32_t length) const {
+	return Line(this->buffer(), this->length(), this->buffer(), 0, this->length()).substr(offset, length);
+}
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef __MPMC_RING_BUFFER_H__
+#define __MPMC_RING_BUFFER_H__
+
+#ifdef __AVR__
+#error "MpmcRingBuffer is only available on the host build"
+#endif
+
+#include <atomic>
+#include <stddef.h>
+
+#include <Arduino.h>
+
+/*
+ * DECLARATION
+ */
+
+/*
+ * Bounded multi producers, multi consumers queue, for the host build where several threads
+ * send AT commands and consume the parsed responses.
+ * Like RingBuffer, the storage is a fixed array of Size elements, no dynamic allocation.
+ * Each slot carries a sequence number telling whether it is ready to be written (seq == pos)
+ * or read (seq == pos + 1) for the lap pos, so producers and consumers only contend on
+ * their own position counter with a compare and swap, never on a lock.
+ */
+template<uint16_t Size, typename T>
+class MpmcRingBuffer {
+
+	static_assert(Size != 0 && (Size & (Size - 1)) == 0, "Size must be a power of two");
+
+public:
+
+	MpmcRingBuffer();
+
+	/* return 1 if c has been queued, 0 if the queue is full */
+	uint16_t append(const T& c);
+
+	/* move up to n first elements to dst, return the number of moved elements */
+	uint16_t read(T* dst, uint16_t n);
+
+	/* only a snapshot, other threads may have modified the queue already */
+	uint16_t length() const;
+
+	bool empty() const;
+
+	static uint16_t capacity();
+
+protected:
+
+	struct Slot {
+		std::atomic<size_t> seq;
+		T data;
+	};
+
+	Slot _slots[Size];
+	alignas(64) std::atomic<size_t> _tail; // next position to write, shared by the producers
+	alignas(64) std::atomic<size_t> _head; // next position to read, shared by the consumers
+
+private:
+
+	bool _pop(T& c);
+};
+
+/*
+ * IMPLEMENTATION
+ */
+
+template<uint16_t Size, typename T>
+MpmcRingBuffer<Size, T>::MpmcRingBuffer() :
+		_tail(0), _head(0) {
+	for (size_t i = 0; i < Size; ++i)
+		_slots[i].seq.store(i, std::memory_order_relaxed);
+}
+
+template<uint16_t Size, typename T>
+uint16_t MpmcRingBuffer<Size, T>::append(const T& c) {
+	size_t pos = _tail.load(std::memory_order_relaxed);
+	Slot* slot;
+	while (true) {
+		slot = &_slots[pos & (Size - 1)];
+		ptrdiff_t diff = (ptrdiff_t) slot->seq.load(std::memory_order_acquire) - (ptrdiff_t) pos;
+		if (diff == 0) {
+			/* the slot is free for this lap, try to claim it */
+			if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		} else if (diff < 0) {
+			/* the slot still holds the element of the previous lap */
+			return 0;
+		} else {
+			/* another producer claimed it */
+			pos = _tail.load(std::memory_order_relaxed);
+		}
+	}
+	slot->data = c;
+	slot->seq.store(pos + 1, std::memory_order_release);
+	return 1;
+}
+
+template<uint16_t Size, typename T>
+uint16_t MpmcRingBuffer<Size, T>::read(T* dst, uint16_t n) {
+	uint16_t count = 0;
+	while (count < n && _pop(dst[count]))
+		++count;
+	return count;
+}
+
+template<uint16_t Size, typename T>
+bool MpmcRingBuffer<Size, T>::_pop(T& c) {
+	size_t pos = _head.load(std::memory_order_relaxed);
+	Slot* slot;
+	while (true) {
+		slot = &_slots[pos & (Size - 1)];
+		ptrdiff_t diff = (ptrdiff_t) slot->seq.load(std::memory_order_acquire) - (ptrdiff_t) (pos + 1);
+		if (diff == 0) {
+			/* the slot has been written for this lap, try to claim it */
+			if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		} else if (diff < 0) {
+			/* nothing written yet */
+			return false;
+		} else {
+			/* another consumer claimed it */
+			pos = _head.load(std::memory_order_relaxed);
+		}
+	}
+	c = slot->data;
+	/* free the slot for the next lap */
+	slot->seq.store(pos + Size, std::memory_order_release);
+	return true;
+}
+
+template<uint16_t Size, typename T>
+uint16_t MpmcRingBuffer<Size, T>::length() const {
+	size_t head = _head.load(std::memory_order_acquire);
+	size_t tail = _tail.load(std::memory_order_acquire);
+	if (tail <= head)
+		return 0;
+	return tail - head > Size ? Size : tail - head;
+}
+
+template<uint16_t Size, typename T>
+bool MpmcRingBuffer<Size, T>::empty() const {
+	return length() == 0;
+}
+
+template<uint16_t Size, typename T>
+uint16_t MpmcRingBuffer<Size, T>::capacity() {
+	return Size;
+}
+
+#endif
@@ -2,19 +2,483 @@
 #define __STRING_BUFFER_H__
 
 #include <Arduino.h>
+#include <stddef.h>
+
+#ifndef __AVR__
+#include <iterator>
+#endif
 
 /*
  * DECLARATION
  */
 
-template<uint16_t Size, typename T>
-class RingBuffer {
+/*
+ * Smallest unsigned type able to hold Size, used to store the indexes.
+ */
+template<uint32_t Size, bool = (Size <= 0xFF), bool = (Size <= 0xFFFF)>
+struct RingIndexType {
+	typedef uint32_t type;
+};
+
+template<uint32_t Size>
+struct RingIndexType<Size, false, true> {
+	typedef uint16_t type;
+};
+
+template<uint32_t Size>
+struct RingIndexType<Size, true, true> {
+	typedef uint8_t type;
+};
+
+/*
+ * Type of the lengths and positions in the public API: uint16_t as before, unless Size needs more.
+ */
+template<uint32_t Size, bool = (Size <= 0xFFFF)>
+struct RingSizeType {
+	typedef uint32_t type;
+};
+
+template<uint32_t Size>
+struct RingSizeType<Size, true> {
+	typedef uint16_t type;
+};
 
+/*
+ * Indexes of the content in the array, selected at compile time from Size.
+ * The generic version stores the start in [0, Size) and the length, the end is derived
+ * with a modulo.
+ */
+template<uint32_t Size, bool = (Size & (Size - 1)) == 0>
+class RingIndex {
 public:
+	typedef typename RingIndexType<Size>::type type;
+
+	RingIndex() :
+			_start(0), _length(0) {
+	}
+	/* position in the array of the first element */
+	type start() const {
+		return _start;
+	}
+	/* position in the array following the last element */
+	type end() const {
+		return at(_length);
+	}
+	/* position in the array of the element idx */
+	type at(uint32_t idx) const {
+		return (_start + idx) % Size;
+	}
+	type length() const {
+		return _length;
+	}
+	void push_back(type n) {
+		_length += n;
+	}
+	void pop_front(type n) {
+		_start = at(n);
+		_length -= n;
+	}
+	void pop_back(type n) {
+		_length -= n;
+	}
+	void clear() {
+		_start = 0;
+		_length = 0;
+	}
+	/* the first element has been moved to the beginning of the array */
+	void rebase() {
+		_start = 0;
+	}
+private:
+	type _start;
+	type _length;
+};
+
+/*
+ * When Size is a power of two, the start and end indexes are free-running and only masked
+ * when accessing the array. The type overflow is harmless as its range is a multiple of Size,
+ * and the length is their difference.
+ */
+template<uint32_t Size>
+class RingIndex<Size, true> {
+public:
+	typedef typename RingIndexType<Size>::type type;
+
+	RingIndex() :
+			_start(0), _end(0) {
+	}
+	type start() const {
+		return _start & (Size - 1);
+	}
+	type end() const {
+		return _end & (Size - 1);
+	}
+	type at(uint32_t idx) const {
+		return (_start + idx) & (Size - 1);
+	}
+	type length() const {
+		return (type) (_end - _start);
+	}
+	void push_back(type n) {
+		_end += n;
+	}
+	void pop_front(type n) {
+		_start += n;
+	}
+	void pop_back(type n) {
+		_end -= n;
+	}
+	void clear() {
+		_start = 0;
+		_end = 0;
+	}
+	void rebase() {
+		_end -= _start;
+		_start = 0;
+	}
+private:
+	type _start;
+	type _end;
+};
+
+/*
+ * Random access iterator over the (at most) two continuous segments of a RingBuffer.
+ * Dereferencing picks the segment with a comparison instead of a modulo, so that STL
+ * algorithms (std::search, std::find, std::copy...) run efficiently over the content.
+ */
+template<typename T, typename S>
+class RingIterator {
+public:
+	typedef T value_type;
+	typedef ptrdiff_t difference_type;
+	typedef const T* pointer;
+	typedef const T& reference;
+#ifndef __AVR__
+	typedef std::random_access_iterator_tag iterator_category;
+#endif
+
+	RingIterator() :
+			_first(nullptr), _first_length(0), _second(nullptr), _idx(0) {
+	}
+	RingIterator(const T* first, S first_length, const T* second, S idx) :
+			_first(first), _first_length(first_length), _second(second), _idx(idx) {
+	}
+
+	reference operator*() const {
+		return _idx < _first_length ? _first[_idx] : _second[_idx - _first_length];
+	}
+	pointer operator->() const {
+		return &**this;
+	}
+	reference operator[](difference_type n) const {
+		return *(*this + n);
+	}
+
+	RingIterator& operator++() {
+		++_idx;
+		return *this;
+	}
+	RingIterator operator++(int) {
+		RingIterator tmp = *this;
+		++_idx;
+		return tmp;
+	}
+	RingIterator& operator--() {
+		--_idx;
+		return *this;
+	}
+	RingIterator operator--(int) {
+		RingIterator tmp = *this;
+		--_idx;
+		return tmp;
+	}
+	RingIterator& operator+=(difference_type n) {
+		_idx += n;
+		return *this;
+	}
+	RingIterator& operator-=(difference_type n) {
+		_idx -= n;
+		return *this;
+	}
+	RingIterator operator+(difference_type n) const {
+		return RingIterator(_first, _first_length, _second, _idx + n);
+	}
+	friend RingIterator operator+(difference_type n, const RingIterator& it) {
+		return it + n;
+	}
+	RingIterator operator-(difference_type n) const {
+		return RingIterator(_first, _first_length, _second, _idx - n);
+	}
+	difference_type operator-(const RingIterator& other) const {
+		return (difference_type) _idx - (difference_type) other._idx;
+	}
+
+	bool operator==(const RingIterator& other) const {
+		return _idx == other._idx;
+	}
+	bool operator!=(const RingIterator& other) const {
+		return _idx != other._idx;
+	}
+	bool operator<(const RingIterator& other) const {
+		return _idx < other._idx;
+	}
+	bool operator>(const RingIterator& other) const {
+		return _idx > other._idx;
+	}
+	bool operator<=(const RingIterator& other) const {
+		return _idx <= other._idx;
+	}
+	bool operator>=(const RingIterator& other) const {
+		return _idx >= other._idx;
+	}
+
+	/* position of the element in the RingBuffer */
+	S index() const {
+		return _idx;
+	}
+
+private:
+	const T* _first;
+	S _first_length;
+	const T* _second;
+	S _idx;
+};
+
+/*
+ * Non-owning view over a part of the content of a StringBuffer, e.g. a line: the (at most)
+ * two segments and the [offset, offset + length) range. Valid until the buffer is modified.
+ */
+template<typename S>
+class RingStringView {
+public:
+	typedef RingIterator<char, S> const_iterator;
+
+	static const S END = -1;
+
+	RingStringView() :
+			_first(nullptr), _first_length(0), _second(nullptr), _offset(0), _length(0) {
+	}
+	RingStringView(const char* first, S first_length, const char* second, S offset, S length) :
+			_first(first), _first_length(first_length), _second(second), _offset(offset), _length(length) {
+	}
+
+	S length() const {
+		return _length;
+	}
+	bool empty() const {
+		return _length == 0;
+	}
+	/* position of the view in the buffer */
+	S offset() const {
+		return _offset;
+	}
+	char operator[](S idx) const {
+		S pos = _offset + idx;
+		return pos < _first_length ? _first[pos] : _second[pos - _first_length];
+	}
+	const_iterator begin() const {
+		return const_iterator(_first, _first_length, _second, _offset);
+	}
+	const_iterator end() const {
+		return const_iterator(_first, _first_length, _second, _offset + _length);
+	}
+
+	bool starts_with(const char* str) const {
+		size_t n = strlen(str);
+		if (n > _length)
+			return false;
+		S end = _offset + n;
+		if (end <= _first_length)
+			return memcmp(_first + _offset, str, n) == 0;
+		if (_offset >= _first_length)
+			return memcmp(_second + (_offset - _first_length), str, n) == 0;
+		S first = _first_length - _offset;
+		return memcmp(_first + _offset, str, first) == 0 && memcmp(_second, str + first, n - first) == 0;
+	}
+	bool equals(const char* str) const {
+		return strlen(str) == _length && starts_with(str);
+	}
+	S index_of(char c, S from = 0) const {
+		for (S i = from; i < _length; ++i)
+			if ((*this)[i] == c)
+				return i;
+		return END;
+	}
+	/* from is clamped to the length, and length to what follows from */
+	RingStringView substr(S from, S length = END) const {
+		if (from > _length)
+			from = _length;
+		if (length > _length - from)
+			length = _length - from;
+		return RingStringView(_first, _first_length, _second, _offset + from, length);
+	}
+	/* without the leading c */
+	RingStringView trim_left(char c = ' ') const {
+		S i = 0;
+		while (i < _length && (*this)[i] == c)
+			++i;
+		return substr(i);
+	}
+
+	/*
+	 * In place parsing, from the beginning of the view, without copy nor strtol/sscanf.
+	 * Each returns how many characters were used, 0 if nothing could be parsed and then
+	 * the output is left untouched.
+	 */
+
+	/* decimal digits, 0 on overflow */
+	S parse_uint(uint32_t* value) const {
+		uint32_t result = 0;
+		S i = 0;
+		for (; i < _length; ++i) {
+			uint8_t digit = (*this)[i] - '0';
+			if (digit > 9)
+				break;
+			if (result > (0xFFFFFFFFUL - digit) / 10)
+				return 0;
+			result = result * 10 + digit;
+		}
+		if (i == 0)
+			return 0;
+		*value = result;
+		return i;
+	}
+	/* optional sign, then decimal digits */
+	S parse_int(int32_t* value) const {
+		bool negative = !empty() && (*this)[0] == '-';
+		S sign = negative || (!empty() && (*this)[0] == '+') ? 1 : 0;
+		uint32_t magnitude;
+		S digits = substr(sign).parse_uint(&magnitude);
+		if (digits == 0 || magnitude > (negative ? 0x80000000UL : 0x7FFFFFFFUL))
+			return 0;
+		*value = negative ? (int32_t) (0 - magnitude) : (int32_t) magnitude;
+		return sign + digits;
+	}
+	/* "text": field is set to the text between the quotes */
+	S parse_quoted(RingStringView* field) const {
+		if (empty() || (*this)[0] != '"')
+			return 0;
+		S end = index_of('"', 1);
+		if (end == END)
+			return 0;
+		*field = substr(1, end - 1);
+		return end + 1;
+	}
+
+	/*
+	 * Comma separated fields: sets field to the one starting at *pos and moves *pos to the
+	 * next one. A separator between quotes does not count. Returns false after the last one.
+	 */
+	bool next_field(S* pos, RingStringView* field, char sep = ',') const {
+		if (*pos > _length)
+			return false;
+		S i = *pos;
+		bool quoted = false;
+		for (; i < _length; ++i) {
+			char c = (*this)[i];
+			if (c == '"')
+				quoted = !quoted;
+			else if (c == sep && !quoted)
+				break;
+		}
+		*field = substr(*pos, i - *pos);
+		*pos = i + 1;
+		return true;
+	}
+	/* field n, from 0, empty if there are less fields */
+	RingStringView field(uint8_t n, char sep = ',') const {
+		S pos = 0;
+		RingStringView result;
+		for (uint8_t i = 0; i <= n; ++i)
+			if (!next_field(&pos, &result, sep))
+				return substr(_length);
+		return result;
+	}
+
+private:
+	const char* _first;
+	S _first_length;
+	const char* _second;
+	S _offset;
+	S _length;
+};
+
+template<typename S>
+const S RingStringView<S>::END;
+
+/*
+ * What append does when the buffer is full, selected at compile time with the Overflow
+ * template parameter of RingBuffer. Only append is concerned, the consume side is the same.
+ * _room() returns how many of the n new elements can be stored, given the free space.
+ */
+
+/* the newest elements are dropped, append returns less than requested. This is the default */
+struct RingDropNew {
+	static const bool keeps_newest = false;
+protected:
+	template<typename Index>
+	uint32_t _room(Index&, uint32_t free, uint32_t n) {
+		return n < free ? n : free;
+	}
+};
+
+/* the oldest elements are evicted in O(1), to keep the latest Size ones. Typically an history */
+struct RingOverwriteOld {
+	static const bool keeps_newest = true;
+protected:
+	template<typename Index>
+	uint32_t _room(Index& index, uint32_t free, uint32_t n) {
+		if (n > free)
+			index.pop_front(n - free);
+		return n;
+	}
+};
+
+/* the newest elements are dropped and counted */
+class RingReportOverflow {
+public:
+	static const bool keeps_newest = false;
+	RingReportOverflow() :
+			_overflows(0) {
+	}
+	/* number of elements dropped since the creation or the last reset_overflows() */
+	uint32_t overflows() const {
+		return _overflows;
+	}
+	void reset_overflows() {
+		_overflows = 0;
+	}
+protected:
+	template<typename Index>
+	uint32_t _room(Index&, uint32_t free, uint32_t n) {
+		if (n <= free)
+			return n;
+		_overflows += n - free;
+		return free;
+	}
+private:
+	uint32_t _overflows;
+};
+
+template<uint32_t Size, typename T, typename Overflow = RingDropNew>
+class RingBuffer: public Overflow {
+
+public:
+
+	typedef typename RingSizeType<Size>::type size_type;
 
 	RingBuffer();
 
-	uint16_t append(T c);
+	size_type append(T c);
+
+	/* copy as many as possible of the n elements of src, return the number of copied elements */
+	size_type append(const T* src, size_type n);
+
+	/* move up to n first elements to dst, return the number of moved elements */
+	size_type read(T* dst, size_type n);
+
+	/* drop up to n first elements in O(1), return the number of dropped elements */
+	size_type discard(size_type n);
 
 	bool full() const;
 
@@ -22,49 +486,77 @@ public:
 
 	void clear();
 
-	uint16_t length() const;
+	size_type length() const;
 	
-	static uint16_t capacity();
+	static size_type capacity();
 
-	const T operator[](uint16_t idx) const;
+	const T operator[](size_type idx) const;
 
 	T pop_first();
 
-	uint16_t pop_firsts(uint16_t n);
+	size_type pop_firsts(size_type n);
 
 	T pop_last();
 
+	struct Segment {
+		const T* data;
+		size_type length;
+	};
+
+	/* content in order of the buffer, second.length is 0 if it does not wrap */
+	struct Segments {
+		Segment first;
+		Segment second;
+	};
+
+	Segments segments() const;
+
+	/* the iterators are invalidated by any modification of the buffer */
+	typedef RingIterator<T, size_type> const_iterator;
+	typedef const_iterator iterator;
+
+	const_iterator begin() const;
+
+	const_iterator end() const;
+
 	const T* buffer();
 
-	static const uint16_t END = -1;
+	static const size_type END = -1;
 
 protected:
 
+	typedef RingIndex<Size> Index;
+
 	bool _is_continuous() const;
 
 	void _make_continuous();
 
+	static void _reverse(T* first, T* last);
+
 	T _buffer[Size];
-	uint16_t _start, _end;
-	uint16_t _length;
-	uint16_t _capacity;
+	Index _index;
 };
 
-template<uint16_t Size, typename T>
-const uint16_t RingBuffer<Size, T>::END;
+template<uint32_t Size, typename T, typename Overflow>
+const typename RingBuffer<Size, T, Overflow>::size_type RingBuffer<Size, T, Overflow>::END;
 
 
-template<uint16_t Size>
-class StringBuffer: public RingBuffer<Size, char> {
+template<uint32_t Size, typename Overflow = RingDropNew>
+class StringBuffer: public RingBuffer<Size, char, Overflow> {
 
 public:
 
-	using RingBuffer<Size, char>::END;
-	using RingBuffer<Size, char>::append;
+	typedef typename RingBuffer<Size, char, Overflow>::size_type size_type;
+	typedef typename RingBuffer<Size, char, Overflow>::const_iterator const_iterator;
+	typedef typename RingBuffer<Size, char, Overflow>::Segments Segments;
+	typedef RingStringView<size_type> Line;
+
+	using RingBuffer<Size, char, Overflow>::END;
+	using RingBuffer<Size, char, Overflow>::append;
 
-	uint16_t append(const char* str);
+	size_type append(const char* str);
 
-	uint16_t index_of(const char* substr, uint16_t offset = 0);
+	size_type index_of(const char* substr, size_type offset = 0);
 
 	bool starts_with(const char* substr);
 
@@ -72,173 +564,347 @@ public:
 
 	bool pop_while(const char subchr);
 
+	/* complete line starting at offset, without its "\r\n", in a single scan and without copy */
+	bool next_line(Line* line, size_type offset = 0);
+
+	/* first complete line starting with prefix, from offset */
+	bool find_line(const char* prefix, Line* line, size_type offset = 0);
+
+	/* pop up to the end of a line given by next_line() or find_line(), "\r\n" included */
+	void consume(const Line& line);
+
+	/* view on the content, e.g. to parse numbers or fields in place */
+	Line view(size_type offset = 0, size_type length = END) const;
+
+protected:
+
+	static bool _matches(const Segments& segs, size_type pos, const char* substr, size_t substr_length);
+
+	static bool _next_line(const Segments& segs, size_type length, Line* line, size_type offset);
+
 };
 
 /*
  * IMPLEMENTATION
  */
 
-template<uint16_t Size, typename T>
-RingBuffer<Size, T>::RingBuffer() :
-		_start(0), _end(0), _length(0), _capacity(Size) {
+template<uint32_t Size, typename T, typename Overflow>
+RingBuffer<Size, T, Overflow>::RingBuffer() {
 }
 
-template<uint16_t Size, typename T>
-uint16_t RingBuffer<Size, T>::append(T c) {
-	if (full())
+template<uint32_t Size, typename T, typename Overflow>
+typename RingBuffer<Size, T, Overflow>::size_type RingBuffer<Size, T, Overflow>::append(T c) {
+	if (this->_room(_index, capacity() - length(), 1) == 0)
 		return 0;
-	_buffer[_end] = c;
-	_end = (_end + 1) % capacity();
-	++_length;
+	_buffer[_index.end()] = c;
+	_index.push_back(1);
 	return 1;
 }
-template<uint16_t Size, typename T>
-bool RingBuffer<Size, T>::full() const {
+
+/* at most two memcpy: up to the end of the array, then from its beginning */
+template<uint32_t Size, typename T, typename Overflow>
+typename RingBuffer<Size, T, Overflow>::size_type RingBuffer<Size, T, Overflow>::append(const T* src, size_type n) {
+	if (Overflow::keeps_newest && n > capacity()) {
+		src += n - capacity();
+		n = capacity();
+	}
+	size_type count = this->_room(_index, capacity() - length(), n);
+	size_type end = _index.end();
+	size_type first = capacity() - end;
+	if (first > count)
+		first = count;
+	memcpy(_buffer + end, src, first * sizeof (T));
+	memcpy(_buffer, src + first, (count - first) * sizeof (T));
+	_index.push_back(count);
+	return count;
+}
+
+template<uint32_t Size, typename T, typename Overflow>
+typename RingBuffer<Size, T, Overflow>::size_type RingBuffer<Size, T, Overflow>::read(T* dst, size_type n) {
+	size_type count = length();
+	if (n < count)
+		count = n;
+	size_type start = _index.start();
+	size_type first = capacity() - start;
+	if (first > count)
+		first = count;
+	memcpy(dst, _buffer + start, first * sizeof (T));
+	memcpy(dst + first, _buffer, (count - first) * sizeof (T));
+	return discard(count);
+}
+
+template<uint32_t Size, typename T, typename Overflow>
+typename RingBuffer<Size, T, Overflow>::size_type RingBuffer<Size, T, Overflow>::discard(size_type n) {
+	if (n > length())
+		n = length();
+	_index.pop_front(n);
+	return n;
+}
+
+template<uint32_t Size, typename T, typename Overflow>
+bool RingBuffer<Size, T, Overflow>::full() const {
 	return capacity() == length();
 }
 
-template<uint16_t Size, typename T>
-bool RingBuffer<Size, T>::empty() const {
+template<uint32_t Size, typename T, typename Overflow>
+bool RingBuffer<Size, T, Overflow>::empty() const {
 	return length() == 0;
 }
 
-template<uint16_t Size, typename T>
-void RingBuffer<Size, T>::clear() {
-	_start = 0;
-	_end = 0;
-	_length = 0;
+template<uint32_t Size, typename T, typename Overflow>
+void RingBuffer<Size, T, Overflow>::clear() {
+	_index.clear();
 }
 
-template<uint16_t Size, typename T>
-uint16_t RingBuffer<Size, T>::length() const {
-	return _length;
+template<uint32_t Size, typename T, typename Overflow>
+typename RingBuffer<Size, T, Overflow>::size_type RingBuffer<Size, T, Overflow>::length() const {
+	return _index.length();
 }
 
-template<uint16_t Size, typename T>
-uint16_t RingBuffer<Size, T>::capacity() {
+template<uint32_t Size, typename T, typename Overflow>
+typename RingBuffer<Size, T, Overflow>::size_type RingBuffer<Size, T, Overflow>::capacity() {
 	return Size;
 }
 
-template<uint16_t Size, typename T>
-const/* can't modify the returned value */T RingBuffer<Size, T>::operator[](
-		uint16_t idx) const {
+template<uint32_t Size, typename T, typename Overflow>
+const/* can't modify the returned value */T RingBuffer<Size, T, Overflow>::operator[](
+		size_type idx) const {
 	if (idx >= length())
 		return _buffer[0]; // declared as undefined behavior for the user
-	return _buffer[(_start + idx) % capacity()];
+	return _buffer[_index.at(idx)];
 }
 
-template<uint16_t Size, typename T>
-T RingBuffer<Size, T>::pop_first() {
+template<uint32_t Size, typename T, typename Overflow>
+T RingBuffer<Size, T, Overflow>::pop_first() {
 	if (empty())
 		return _buffer[0];
-	uint8_t t = _start;
-	_start = (_start + 1) % capacity();
-	--_length;
+	size_type t = _index.start();
+	_index.pop_front(1);
 	return _buffer[t];
 }
 
-template<uint16_t Size, typename T>
-uint16_t RingBuffer<Size, T>::pop_firsts(uint16_t n) {
-	uint16_t count = 0;
-	while (!empty() && n--) {
-		pop_first();
-		++count;
-	}
-	return count;
+template<uint32_t Size, typename T, typename Overflow>
+typename RingBuffer<Size, T, Overflow>::size_type RingBuffer<Size, T, Overflow>::pop_firsts(size_type n) {
+	return discard(n);
 }
 
-template<uint16_t Size, typename T>
-T RingBuffer<Size, T>::pop_last() {
+template<uint32_t Size, typename T, typename Overflow>
+T RingBuffer<Size, T, Overflow>::pop_last() {
 	if (empty())
 		return _buffer[0];
-	--_length;
-	_end = (_start + length()) % capacity();
-	return _buffer[_end];
+	_index.pop_back(1);
+	return _buffer[_index.end()];
+}
+
+/* never modifies the buffer, nor copies its content */
+template<uint32_t Size, typename T, typename Overflow>
+typename RingBuffer<Size, T, Overflow>::Segments RingBuffer<Size, T, Overflow>::segments() const {
+	size_type start = _index.start();
+	size_type first = capacity() - start;
+	if (first > length())
+		first = length();
+	Segments segs = { { _buffer + start, first }, { _buffer, (size_type)(length() - first) } };
+	return segs;
+}
+
+template<uint32_t Size, typename T, typename Overflow>
+typename RingBuffer<Size, T, Overflow>::const_iterator RingBuffer<Size, T, Overflow>::begin() const {
+	Segments segs = segments();
+	return const_iterator(segs.first.data, segs.first.length, segs.second.data, 0);
 }
 
-/* can cause a call to memmove */
-template<uint16_t Size, typename T>
-const T* RingBuffer<Size, T>::buffer() {
+template<uint32_t Size, typename T, typename Overflow>
+typename RingBuffer<Size, T, Overflow>::const_iterator RingBuffer<Size, T, Overflow>::end() const {
+	Segments segs = segments();
+	return const_iterator(segs.first.data, segs.first.length, segs.second.data, length());
+}
+
+/* can cause an O(Size) rotation of the content. Prefer segments() when possible */
+template<uint32_t Size, typename T, typename Overflow>
+const T* RingBuffer<Size, T, Overflow>::buffer() {
 	if (!_is_continuous())
 		_make_continuous();
-	return _buffer + _start;
+	return _buffer + _index.start();
 }
 
-template<uint16_t Size, typename T>
-bool RingBuffer<Size, T>::_is_continuous() const {
+template<uint32_t Size, typename T, typename Overflow>
+bool RingBuffer<Size, T, Overflow>::_is_continuous() const {
 	/* is empty */
 	bool res = empty();
 	/* content is somewhere in the middle of buffer */
-	res = res || _start < _end;
+	res = res || _index.start() < _index.end();
 	/* buffer has not cyclied yet */
-	res = res || _end == 0;
+	res = res || _index.end() == 0;
 	return res;
 }
 
-template<uint16_t Size, typename T>
-void RingBuffer<Size, T>::_make_continuous() {
-	while (!_is_continuous()) {
-		T tmp = _buffer[0];
-		memmove(&(_buffer[0]), &(_buffer[1]), (_end - 1) * sizeof (T));
-		memmove(&(_buffer[_start - 1]), &(_buffer[_start]), (capacity() - _start) * sizeof (T));
-		_buffer[capacity() - 1] = tmp;
-		_start = (_start - 1) % capacity();
-		_end = (_start + length()) % capacity();
+/* rotate the array left by the start position, with three reversals */
+template<uint32_t Size, typename T, typename Overflow>
+void RingBuffer<Size, T, Overflow>::_make_continuous() {
+	size_type start = _index.start();
+	_reverse(_buffer, _buffer + start);
+	_reverse(_buffer + start, _buffer + capacity());
+	_reverse(_buffer, _buffer + capacity());
+	_index.rebase();
+}
+
+template<uint32_t Size, typename T, typename Overflow>
+void RingBuffer<Size, T, Overflow>::_reverse(T* first, T* last) {
+	while (first != last && first != --last) {
+		T tmp = *first;
+		*first++ = *last;
+		*last = tmp;
 	}
 }
 
-template<uint16_t Size>
-uint16_t StringBuffer<Size>::append(const char* str) {
-	uint16_t count = 0;
+template<uint32_t Size, typename Overflow>
+typename StringBuffer<Size, Overflow>::size_type StringBuffer<Size, Overflow>::append(const char* str) {
 	size_t str_length = strlen(str);
-	for (uint16_t i = 0; i < str_length; ++i) {
-		if (!this->append(str[i])) {
-			return count;
-		}
-		++count;
-	}
-	return count;
+	if (str_length > (size_type) -1)
+		str_length = (size_type) -1;
+	return this->append(str, str_length);
 }
 
-template<uint16_t Size>
-uint16_t StringBuffer<Size>::index_of(const char* substr, uint16_t offset) {
-        if (this->empty())
-    		return StringBuffer<Size>::END;
-        size_t substr_length = strlen(substr);
-        if (substr_length + offset > this->length())
-		return StringBuffer<Size>::END;
-	for (uint16_t i = offset; i <= this->length() - substr_length; ++i) {
-		bool match = true;
-		for (uint16_t j = 0; j < substr_length && match; ++j) {
-			match = match && ((*this)[i + j] == substr[j]);
+/*
+ * memchr finds the candidates for the first character, one segment after the other,
+ * and memcmp verifies them, including when they straddle the two segments.
+ * Both are optimized by the C library (vectorized on the host, assembly in avr-libc).
+ */
+template<uint32_t Size, typename Overflow>
+typename StringBuffer<Size, Overflow>::size_type StringBuffer<Size, Overflow>::index_of(const char* substr, size_type offset) {
+	if (this->empty())
+		return StringBuffer<Size, Overflow>::END;
+	size_t substr_length = strlen(substr);
+	if (substr_length + offset > this->length())
+		return StringBuffer<Size, Overflow>::END;
+	if (substr_length == 0)
+		return offset;
+	Segments segs = this->segments();
+	/* candidates are in [offset, end) */
+	size_type pos = offset;
+	size_type end = this->length() - substr_length + 1;
+	while (pos < end) {
+		const char* from;
+		size_type count;
+		if (pos < segs.first.length) {
+			from = segs.first.data + pos;
+			count = (end < segs.first.length ? end : segs.first.length) - pos;
+		} else {
+			from = segs.second.data + (pos - segs.first.length);
+			count = end - pos;
+		}
+		const char* found = (const char*) memchr(from, substr[0], count);
+		if (found == nullptr) {
+			pos += count;
+			continue;
 		}
-		if (match)
-			return i;
+		pos += found - from;
+		if (_matches(segs, pos, substr, substr_length))
+			return pos;
+		++pos;
 	}
-	return StringBuffer<Size>::END;
+	return StringBuffer<Size, Overflow>::END;
+}
+
+template<uint32_t Size, typename Overflow>
+bool StringBuffer<Size, Overflow>::starts_with(const char* substr) {
+	size_t substr_length = strlen(substr);
+	if (this->empty() || substr_length > this->length())
+		return false;
+	return _matches(this->segments(), 0, substr, substr_length);
 }
 
-template<uint16_t Size>
-bool StringBuffer<Size>::starts_with(const char* substr) {
-	return (this->index_of(substr) == 0);
+/* substr_length elements from pos must be in the buffer */
+template<uint32_t Size, typename Overflow>
+bool StringBuffer<Size, Overflow>::_matches(const Segments& segs, size_type pos, const char* substr, size_t substr_length) {
+	if (pos >= segs.first.length)
+		return memcmp(segs.second.data + (pos - segs.first.length), substr, substr_length) == 0;
+	size_t first = segs.first.length - pos;
+	if (first >= substr_length)
+		return memcmp(segs.first.data + pos, substr, substr_length) == 0;
+	return memcmp(segs.first.data + pos, substr, first) == 0
+			&& memcmp(segs.second.data, substr + first, substr_length - first) == 0;
 }
 
-template<uint16_t Size>
-bool StringBuffer<Size>::pop_until(const char* substr) {
-	uint16_t offset = index_of(substr);
-	if (offset == StringBuffer<Size>::END)
+template<uint32_t Size, typename Overflow>
+bool StringBuffer<Size, Overflow>::pop_until(const char* substr) {
+	size_type offset = index_of(substr);
+	if (offset == StringBuffer<Size, Overflow>::END)
 		return false;
 	this->pop_firsts(offset + strlen(substr));
 	return true;
 }
 
-template<uint16_t Size>
-bool StringBuffer<Size>::pop_while(const char subchr) {
-	if (this->empty() || (*this)[0] != subchr)
+template<uint32_t Size, typename Overflow>
+bool StringBuffer<Size, Overflow>::pop_while(const char subchr) {
+	const_iterator it = this->begin();
+	const_iterator last = this->end();
+	while (it != last && *it == subchr)
+		++it;
+	return this->pop_firsts(it.index()) != 0;
+}
+
+template<uint32_t Size, typename Overflow>
+bool StringBuffer<Size, Overflow>::next_line(Line* line, size_type offset) {
+	return _next_line(this->segments(), this->length(), line, offset);
+}
+
+template<uint32_t Size, typename Overflow>
+bool StringBuffer<Size, Overflow>::find_line(const char* prefix, Line* line, size_type offset) {
+	Segments segs = this->segments();
+	size_type length = this->length();
+	while (_next_line(segs, length, line, offset)) {
+		if (line->starts_with(prefix))
+			return true;
+		offset = line->offset() + line->length() + 2;
+	}
+	return false;
+}
+
+/*
+ * memchr finds the '\n' one segment after the other, the line ends if a '\r' precedes it.
+ */
+template<uint32_t Size, typename Overflow>
+bool StringBuffer<Size, Overflow>::_next_line(const Segments& segs, size_type length, Line* line, size_type offset) {
+	if (offset >= length)
 		return false;
-	while (!this->empty() && (*this)[0] == subchr)
-		this->pop_first();
-	return true;
+	size_type pos = offset + 1;
+	while (pos < length) {
+		const char* from;
+		size_type count;
+		if (pos < segs.first.length) {
+			from = segs.first.data + pos;
+			count = segs.first.length - pos;
+		} else {
+			from = segs.second.data + (pos - segs.first.length);
+			count = length - pos;
+		}
+		const char* found = (const char*) memchr(from, '\n', count);
+		if (found == nullptr) {
+			pos += count;
+			continue;
+		}
+		pos += found - from;
+		/* the '\r' is in the previous segment when '\n' starts the second one */
+		char previous = pos == segs.first.length ? segs.first.data[pos - 1] : found[-1];
+		if (previous == '\r') {
+			*line = Line(segs.first.data, segs.first.length, segs.second.data, offset, pos - 1 - offset);
+			return true;
+		}
+		++pos;
+	}
+	return false;
+}
+
+template<uint32_t Size, typename Overflow>
+void StringBuffer<Size, Overflow>::consume(const Line& line) {
+	this->pop_firsts(line.offset() + line.length() + 2);
+}
+
+template<uint32_t Size, typename Overflow>
+typename StringBuffer<Size, Overflow>::Line StringBuffer<Size, Overflow>::view(size_type offset, size_type length) const {
+	Segments segs = this->segments();
+	return Line(segs.first.data, segs.first.length, segs.second.data, 0, this->length()).substr(offset, length);
 }
 
 #endif
@@ -0,0 +1,132 @@
+#ifndef __SEARCH_CURSOR_H__
+#define __SEARCH_CURSOR_H__
+
+#include <Arduino.h>
+#include <string.h>
+
+/*
+ * Resumable search of a string in a StringBuffer being filled.
+ * poll() only scans the bytes appended since the previous call, plus the strlen(token) - 1
+ * last ones where a partial match may continue, instead of the whole buffer each time.
+ *
+ * SearchCursor<StringBuffer<1024> > ok(buffer, "OK\r\n");
+ * while (ok.poll() == buffer.END) { ... buffer.append(serial.read()); ... }
+ * ok.pop_until(); // consume up to the end of "OK\r\n"
+ *
+ * The content must only be consumed through the cursor, or be reported with consumed(n).
+ * Not to be used with RingOverwriteOld, which consumes the content while appending.
+ */
+
+/*
+ * DECLARATION
+ */
+
+template<typename Buffer>
+class SearchCursor {
+
+public:
+
+	typedef typename Buffer::size_type size_type;
+
+	SearchCursor(Buffer& buffer, const char* token);
+
+	/* index of the token, Buffer::END if not in the buffer yet */
+	size_type poll();
+
+	/* n elements were popped from the front of the buffer */
+	void consumed(size_type n);
+
+	/* start again from the beginning of the buffer, e.g. after clear() */
+	void reset();
+
+	/* position before which the token cannot start, unless already found */
+	size_type scanned() const;
+
+	/* consume from the buffer and keep the cursor in sync */
+	char pop_first();
+
+	size_type pop_firsts(size_type n);
+
+	/* consume up to the end of the token, return false if not found */
+	bool pop_until();
+
+private:
+
+	Buffer& _buffer;
+	const char* _token;
+	size_type _token_length;
+	size_type _from;
+	size_type _found;
+};
+
+/*
+ * IMPLEMENTATION
+ */
+
+template<typename Buffer>
+SearchCursor<Buffer>::SearchCursor(Buffer& buffer, const char* token) :
+		_buffer(buffer), _token(token), _token_length(strlen(token)), _from(0), _found(Buffer::END) {
+}
+
+template<typename Buffer>
+typename SearchCursor<Buffer>::size_type SearchCursor<Buffer>::poll() {
+	if (_found != Buffer::END)
+		return _found;
+	size_type length = _buffer.length();
+	/* content removed behind our back */
+	if (length < _from)
+		_from = 0;
+	_found = _buffer.index_of(_token, _from);
+	if (_found == Buffer::END && length >= _token_length)
+		_from = length - _token_length + 1;
+	return _found;
+}
+
+template<typename Buffer>
+void SearchCursor<Buffer>::consumed(size_type n) {
+	if (_found != Buffer::END && n <= _found) {
+		_found -= n;
+	} else {
+		/* the match, if any, was consumed: what follows it is not scanned */
+		if (_found != Buffer::END)
+			_from = 0;
+		_found = Buffer::END;
+	}
+	_from = n < _from ? _from - n : 0;
+}
+
+template<typename Buffer>
+void SearchCursor<Buffer>::reset() {
+	_from = 0;
+	_found = Buffer::END;
+}
+
+template<typename Buffer>
+typename SearchCursor<Buffer>::size_type SearchCursor<Buffer>::scanned() const {
+	return _from;
+}
+
+template<typename Buffer>
+char SearchCursor<Buffer>::pop_first() {
+	if (!_buffer.empty())
+		consumed(1);
+	return _buffer.pop_first();
+}
+
+template<typename Buffer>
+typename SearchCursor<Buffer>::size_type SearchCursor<Buffer>::pop_firsts(size_type n) {
+	n = _buffer.pop_firsts(n);
+	consumed(n);
+	return n;
+}
+
+template<typename Buffer>
+bool SearchCursor<Buffer>::pop_until() {
+	size_type pos = poll();
+	if (pos == Buffer::END)
+		return false;
+	pop_firsts(pos + _token_length);
+	return true;
+}
+
+#endif
@@ -0,0 +1,217 @@
+#ifndef __SPSC_RING_BUFFER_H__
+#define __SPSC_RING_BUFFER_H__
+
+#include <Arduino.h>
+
+#ifdef __AVR__
+#include <util/atomic.h>
+#else
+#include <atomic>
+#endif
+
+/*
+ * DECLARATION
+ */
+
+/*
+ * Index shared between the producer and the consumer.
+ * On AVR, a uint16_t access takes two instructions, so it is done with interrupts disabled.
+ * ATOMIC_BLOCK also acts as a compiler memory barrier, which gives the acquire/release ordering.
+ */
+#ifdef __AVR__
+class SpscIndex {
+public:
+	SpscIndex() : _value(0) {
+	}
+	uint16_t load_relaxed() const {
+		return _value;
+	}
+	uint16_t load_acquire() const {
+		uint16_t value;
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+			value = _value;
+		}
+		return value;
+	}
+	void store_release(uint16_t value) {
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+			_value = value;
+		}
+	}
+private:
+	volatile uint16_t _value;
+};
+#else
+class alignas(64) SpscIndex { // one cache line each, to avoid false sharing between the threads
+public:
+	SpscIndex() : _value(0) {
+	}
+	uint16_t load_relaxed() const {
+		return _value.load(std::memory_order_relaxed);
+	}
+	uint16_t load_acquire() const {
+		return _value.load(std::memory_order_acquire);
+	}
+	void store_release(uint16_t value) {
+		_value.store(value, std::memory_order_release);
+	}
+private:
+	std::atomic<uint16_t> _value;
+};
+#endif
+
+/*
+ * Single producer, single consumer RingBuffer, typically an ISR (or a reader thread) pushing
+ * bytes while loop() drains them.
+ * The producer only writes _tail, the consumer only writes _head. Both are free-running,
+ * so the length is _tail - _head and there is no shared counter to tear.
+ *
+ * Producer side: append(), full()
+ * Consumer side: pop_first(), read(), discard(), operator[], empty()
+ * length() is safe on both sides, but only a lower bound (consumer) or an upper bound (producer).
+ */
+template<uint16_t Size, typename T>
+class SpscRingBuffer {
+
+	static_assert(Size != 0 && (Size & (Size - 1)) == 0, "Size must be a power of two");
+	static_assert(Size <= 32768, "Size must fit in the uint16_t free-running indexes");
+
+public:
+
+	SpscRingBuffer();
+
+	uint16_t append(T c);
+
+	uint16_t append(const T* src, uint16_t n);
+
+	bool full() const;
+
+	bool empty() const;
+
+	uint16_t length() const;
+
+	static uint16_t capacity();
+
+	const T operator[](uint16_t idx) const;
+
+	T pop_first();
+
+	uint16_t read(T* dst, uint16_t n);
+
+	uint16_t discard(uint16_t n);
+
+protected:
+
+	static uint16_t _pos(uint16_t idx);
+
+	T _buffer[Size];
+	SpscIndex _head; // next element to consume, written by the consumer
+	SpscIndex _tail; // next free slot, written by the producer
+};
+
+/*
+ * IMPLEMENTATION
+ */
+
+template<uint16_t Size, typename T>
+SpscRingBuffer<Size, T>::SpscRingBuffer() {
+}
+
+template<uint16_t Size, typename T>
+uint16_t SpscRingBuffer<Size, T>::append(T c) {
+	uint16_t tail = _tail.load_relaxed();
+	if ((uint16_t)(tail - _head.load_acquire()) == capacity())
+		return 0;
+	_buffer[_pos(tail)] = c;
+	_tail.store_release(tail + 1);
+	return 1;
+}
+
+template<uint16_t Size, typename T>
+uint16_t SpscRingBuffer<Size, T>::append(const T* src, uint16_t n) {
+	uint16_t tail = _tail.load_relaxed();
+	uint16_t count = capacity() - (uint16_t)(tail - _head.load_acquire());
+	if (n < count)
+		count = n;
+	uint16_t end = _pos(tail);
+	uint16_t first = capacity() - end;
+	if (first > count)
+		first = count;
+	memcpy(_buffer + end, src, first * sizeof (T));
+	memcpy(_buffer, src + first, (count - first) * sizeof (T));
+	_tail.store_release(tail + count);
+	return count;
+}
+
+template<uint16_t Size, typename T>
+bool SpscRingBuffer<Size, T>::full() const {
+	return length() == capacity();
+}
+
+template<uint16_t Size, typename T>
+bool SpscRingBuffer<Size, T>::empty() const {
+	return length() == 0;
+}
+
+template<uint16_t Size, typename T>
+uint16_t SpscRingBuffer<Size, T>::length() const {
+	/* head first: the tail loaded after can only be further, never behind it */
+	uint16_t head = _head.load_acquire();
+	return _tail.load_acquire() - head;
+}
+
+template<uint16_t Size, typename T>
+uint16_t SpscRingBuffer<Size, T>::capacity() {
+	return Size;
+}
+
+template<uint16_t Size, typename T>
+const T SpscRingBuffer<Size, T>::operator[](uint16_t idx) const {
+	uint16_t head = _head.load_relaxed();
+	if (idx >= (uint16_t)(_tail.load_acquire() - head))
+		return _buffer[0]; // declared as undefined behavior for the user
+	return _buffer[_pos(head + idx)];
+}
+
+template<uint16_t Size, typename T>
+T SpscRingBuffer<Size, T>::pop_first() {
+	uint16_t head = _head.load_relaxed();
+	if (_tail.load_acquire() == head)
+		return _buffer[0];
+	T c = _buffer[_pos(head)];
+	_head.store_release(head + 1);
+	return c;
+}
+
+template<uint16_t Size, typename T>
+uint16_t SpscRingBuffer<Size, T>::read(T* dst, uint16_t n) {
+	uint16_t head = _head.load_relaxed();
+	uint16_t count = _tail.load_acquire() - head;
+	if (n < count)
+		count = n;
+	uint16_t start = _pos(head);
+	uint16_t first = capacity() - start;
+	if (first > count)
+		first = count;
+	memcpy(dst, _buffer + start, first * sizeof (T));
+	memcpy(dst + first, _buffer, (count - first) * sizeof (T));
+	_head.store_release(head + count);
+	return count;
+}
+
+template<uint16_t Size, typename T>
+uint16_t SpscRingBuffer<Size, T>::discard(uint16_t n) {
+	uint16_t head = _head.load_relaxed();
+	uint16_t count = _tail.load_acquire() - head;
+	if (n < count)
+		count = n;
+	_head.store_release(head + count);
+	return count;
+}
+
+template<uint16_t Size, typename T>
+uint16_t SpscRingBuffer<Size, T>::_pos(uint16_t idx) {
+	return idx & (Size - 1);
+}
+
+#endif
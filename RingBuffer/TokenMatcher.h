@@ -0,0 +1,412 @@
+#ifndef __TOKEN_MATCHER_H__
+#define __TOKEN_MATCHER_H__
+
+#include <Arduino.h>
+#include <stddef.h>
+
+/*
+ * Multi-pattern matcher: finds the first occurrence of any token of a table in a single
+ * pass over a StringBuffer, whatever the number of tokens (Aho-Corasick automaton).
+ * The automaton is computed by the compiler from the table and stored in flash (PROGMEM).
+ *
+ * TOKEN_TABLE(AtTokens, "OK\r\n", "ERROR\r\n", "+CPIN:")
+ * typedef TokenMatcher<AtTokens> AtMatcher;
+ * uint16_t pos;
+ * uint8_t token = AtMatcher::find(buffer, &pos); // index in the table, or AtMatcher::NONE
+ *
+ * The match reported is the one that ends first, the longest one if several end there.
+ * At most 254 tokens and 255 characters in total.
+ */
+
+/*
+ * DECLARATION
+ */
+
+template<typename... Tokens>
+constexpr uint8_t _token_count(Tokens...) {
+	return sizeof...(Tokens);
+}
+
+constexpr const char* _token_nth(uint8_t) {
+	return "";
+}
+
+template<typename... Tokens>
+constexpr const char* _token_nth(uint8_t idx, const char* first, Tokens... others) {
+	return idx == 0 ? first : _token_nth(idx - 1, others...);
+}
+
+#define TOKEN_TABLE(name, ...)																		\
+struct name {																						\
+	static constexpr uint8_t count() { return _token_count(__VA_ARGS__); }							\
+	static constexpr const char* token(uint8_t idx) { return _token_nth(idx, __VA_ARGS__); }		\
+};
+
+/* compile-time sequence 0, 1, ..., N - 1, built with a logarithmic depth */
+template<size_t... I>
+struct _TokenIndexes {
+};
+
+template<typename A, typename B>
+struct _TokenConcat;
+
+template<size_t... A, size_t... B>
+struct _TokenConcat<_TokenIndexes<A...>, _TokenIndexes<B...> > {
+	typedef _TokenIndexes<A..., (sizeof...(A) + B)...> type;
+};
+
+template<size_t N>
+struct _TokenMakeIndexes {
+	typedef typename _TokenConcat<typename _TokenMakeIndexes<N / 2>::type,
+			typename _TokenMakeIndexes<N - N / 2>::type>::type type;
+};
+
+template<>
+struct _TokenMakeIndexes<0> {
+	typedef _TokenIndexes<> type;
+};
+
+template<>
+struct _TokenMakeIndexes<1> {
+	typedef _TokenIndexes<0> type;
+};
+
+/* Fn::at(0), ..., Fn::at(N - 1), usable by the compiler */
+template<typename Fn, size_t N, typename Indexes = typename _TokenMakeIndexes<N>::type>
+struct _TokenArray;
+
+template<typename Fn, size_t N, size_t... I>
+struct _TokenArray<Fn, N, _TokenIndexes<I...> > {
+	static constexpr uint8_t values[N] = { Fn::at(I)... };
+};
+
+template<typename Fn, size_t N, size_t... I>
+constexpr uint8_t _TokenArray<Fn, N, _TokenIndexes<I...> >::values[N];
+
+/* Fn::at(0), ..., Fn::at(N - 1), stored in flash */
+template<typename Fn, size_t N, typename Indexes = typename _TokenMakeIndexes<N>::type>
+struct _TokenFlash;
+
+template<typename Fn, size_t N, size_t... I>
+struct _TokenFlash<Fn, N, _TokenIndexes<I...> > {
+	static const uint8_t values[N];
+};
+
+template<typename Fn, size_t N, size_t... I>
+const uint8_t _TokenFlash<Fn, N, _TokenIndexes<I...> >::values[N] PROGMEM = { Fn::at(I)... };
+
+/*
+ * Compile-time construction of the automaton.
+ * A state is a prefix of a token, numbered by the position of its last character in the
+ * concatenation of the tokens (0 is the empty prefix). Characters are grouped in classes:
+ * 0 for the ones in no token, then one per distinct character of the tokens.
+ * A transition goes to the longest suffix of "state + character" which is a prefix of a token.
+ * Each step is tabulated so that the next one only does array lookups.
+ */
+constexpr uint8_t _token_strlen(const char* str) {
+	return *str ? 1 + _token_strlen(str + 1) : 0;
+}
+
+template<typename Tokens>
+constexpr uint16_t _token_total(uint8_t token) {
+	return token == Tokens::count() ? 0 : _token_strlen(Tokens::token(token)) + _token_total<Tokens>(token + 1);
+}
+
+template<typename Tokens>
+struct _TokenSizes {
+	static const uint8_t COUNT = Tokens::count();
+	static const uint16_t STATES = 1 + _token_total<Tokens>(0);
+};
+
+/* state of the first character of each token minus one, then the last state */
+template<typename Tokens>
+struct _TokenOffset {
+	static constexpr uint8_t at(size_t token) {
+		return token == 0 ? 0 : at(token - 1) + _token_strlen(Tokens::token(token - 1));
+	}
+};
+
+/* token of each state */
+template<typename Tokens>
+struct _TokenOwner {
+	typedef _TokenArray<_TokenOffset<Tokens>, _TokenSizes<Tokens>::COUNT + 1> Offset;
+	static constexpr uint8_t at(size_t id, uint8_t token = 0) {
+		return id <= Offset::values[token + 1] ? token : at(id, token + 1);
+	}
+};
+
+/* last character of each state */
+template<typename Tokens>
+struct _TokenChar {
+	typedef _TokenArray<_TokenOffset<Tokens>, _TokenSizes<Tokens>::COUNT + 1> Offset;
+	typedef _TokenArray<_TokenOwner<Tokens>, _TokenSizes<Tokens>::STATES> Owner;
+	static constexpr uint8_t at(size_t id) {
+		return id == 0 ? 0 : Tokens::token(Owner::values[id])[id - Offset::values[Owner::values[id]] - 1];
+	}
+};
+
+/* first state ending with the same character */
+template<typename Tokens>
+struct _TokenFirst {
+	typedef _TokenArray<_TokenChar<Tokens>, _TokenSizes<Tokens>::STATES> Char;
+	static constexpr uint8_t _find(size_t id, size_t before, size_t first) {
+		return before == 0 ? first : _find(id, before - 1, Char::values[before] == Char::values[id] ? before : first);
+	}
+	static constexpr uint8_t at(size_t id) {
+		return id == 0 ? 0 : _find(id, id - 1, id);
+	}
+};
+
+/* class of the last character of each state */
+template<typename Tokens>
+struct _TokenRank {
+	typedef _TokenArray<_TokenFirst<Tokens>, _TokenSizes<Tokens>::STATES> First;
+	static constexpr uint8_t distinct(size_t id) {
+		return id == 0 ? 0 : distinct(id - 1) + (First::values[id] == id ? 1 : 0);
+	}
+	static constexpr uint8_t at(size_t id) {
+		return id == 0 ? 0 : distinct(First::values[id]);
+	}
+};
+
+template<typename Tokens>
+struct _TokenClasses {
+	static const uint16_t CLASSES = 1 + _TokenRank<Tokens>::distinct(_TokenSizes<Tokens>::STATES - 1);
+};
+
+/* class of each character */
+template<typename Tokens>
+struct _TokenClass {
+	static const uint16_t STATES = _TokenSizes<Tokens>::STATES;
+	typedef _TokenArray<_TokenChar<Tokens>, STATES> Char;
+	typedef _TokenArray<_TokenRank<Tokens>, STATES> Rank;
+	static constexpr uint8_t at(size_t c, size_t id = 1) {
+		return id == STATES ? 0 : Char::values[id] == c ? Rank::values[id] : at(c, id + 1);
+	}
+};
+
+/* character of each class */
+template<typename Tokens>
+struct _TokenClassChar {
+	typedef _TokenArray<_TokenChar<Tokens>, _TokenSizes<Tokens>::STATES> Char;
+	typedef _TokenArray<_TokenRank<Tokens>, _TokenSizes<Tokens>::STATES> Rank;
+	static constexpr uint8_t at(size_t k, size_t id = 1) {
+		return k == 0 ? 0 : Rank::values[id] == k ? Char::values[id] : at(k, id + 1);
+	}
+};
+
+/* canonical state of each prefix: the one of the first token starting with it */
+template<typename Tokens>
+struct _TokenCanonical {
+	static const uint8_t COUNT = _TokenSizes<Tokens>::COUNT;
+	typedef _TokenArray<_TokenOffset<Tokens>, COUNT + 1> Offset;
+	typedef _TokenArray<_TokenOwner<Tokens>, _TokenSizes<Tokens>::STATES> Owner;
+	typedef _TokenArray<_TokenChar<Tokens>, _TokenSizes<Tokens>::STATES> Char;
+
+	static constexpr uint8_t length(uint8_t token) {
+		return Offset::values[token + 1] - Offset::values[token];
+	}
+	static constexpr uint8_t depth(size_t id) {
+		return id - Offset::values[Owner::values[id]];
+	}
+	static constexpr bool _same(size_t id, uint8_t token, uint8_t n) {
+		return n == 0 ? true : Char::values[id - n + 1] == Char::values[Offset::values[token] + depth(id) - n + 1]
+				&& _same(id, token, n - 1);
+	}
+	static constexpr uint8_t at(size_t id, uint8_t token = 0) {
+		return length(token) >= depth(id) && _same(id, token, depth(id)) ? Offset::values[token] + depth(id) : at(id, token + 1);
+	}
+};
+
+/* Aho-Corasick goto function: child of the canonical state id by character c, 0 if none */
+template<typename Tokens>
+struct _TokenGoto {
+	static const uint8_t COUNT = _TokenSizes<Tokens>::COUNT;
+	typedef _TokenCanonical<Tokens> C;
+	typedef _TokenArray<_TokenCanonical<Tokens>, _TokenSizes<Tokens>::STATES> Canonical;
+
+	static constexpr uint8_t child(size_t id, uint8_t c) {
+		return _child(id, C::depth(id), c, 0);
+	}
+	static constexpr uint8_t _child(size_t id, uint8_t depth, uint8_t c, uint8_t token) {
+		return token == COUNT ? 0 : _child_of(id, depth, c, token, C::Offset::values[token] + depth);
+	}
+	/* state is the one of token at the depth of id */
+	static constexpr uint8_t _child_of(size_t id, uint8_t depth, uint8_t c, uint8_t token, size_t state) {
+		return state < C::Offset::values[token + 1] && (depth == 0 || Canonical::values[state] == id)
+				&& C::Char::values[state + 1] == c ? Canonical::values[state + 1] : _child(id, depth, c, token + 1);
+	}
+	/* follows the failure links until a state has a child by c */
+	template<typename Fail>
+	static constexpr uint8_t next(size_t id, uint8_t c) {
+		return _next<Fail>(id, c, child(id, c));
+	}
+	template<typename Fail>
+	static constexpr uint8_t _next(size_t id, uint8_t c, uint8_t to) {
+		return to != 0 || id == 0 ? to : next<Fail>(Fail::values[id], c);
+	}
+};
+
+template<typename Tokens>
+constexpr uint8_t _token_max_length(uint8_t token = 0, uint8_t longest = 0) {
+	return token == Tokens::count() ? longest : _token_max_length<Tokens>(token + 1,
+			_TokenCanonical<Tokens>::length(token) > longest ? _TokenCanonical<Tokens>::length(token) : longest);
+}
+
+/*
+ * Aho-Corasick failure links: the longest proper suffix being a prefix, for the states up to
+ * Depth. Computed depth after depth as it relies on the links of the shorter states.
+ */
+template<typename Tokens, uint8_t Depth = _token_max_length<Tokens>()>
+struct _TokenFail {
+	typedef _TokenCanonical<Tokens> C;
+	typedef _TokenArray<_TokenCanonical<Tokens>, _TokenSizes<Tokens>::STATES> Canonical;
+	typedef _TokenArray<_TokenFail<Tokens, Depth - 1>, _TokenSizes<Tokens>::STATES> Shorter;
+
+	static constexpr uint8_t at(size_t id) {
+		return C::depth(id) < Depth ? Shorter::values[id] :
+				Depth <= 1 ? 0 : _TokenGoto<Tokens>::template next<Shorter>(Shorter::values[Canonical::values[id - 1]], C::Char::values[id]);
+	}
+};
+
+template<typename Tokens>
+struct _TokenFail<Tokens, 0> {
+	static constexpr uint8_t at(size_t) {
+		return 0;
+	}
+};
+
+/* entry n of the transitions table: from state n / CLASSES with class n % CLASSES */
+template<typename Tokens>
+struct _TokenTransition {
+	static const uint16_t STATES = _TokenSizes<Tokens>::STATES;
+	static const uint16_t CLASSES = _TokenClasses<Tokens>::CLASSES;
+	typedef _TokenArray<_TokenCanonical<Tokens>, STATES> Canonical;
+	typedef _TokenArray<_TokenClassChar<Tokens>, CLASSES> ClassChar;
+	typedef _TokenArray<_TokenFail<Tokens>, STATES> Fail;
+
+	/* only canonical states are reachable */
+	static constexpr uint8_t at(size_t n) {
+		return n % CLASSES == 0 || Canonical::values[n / CLASSES] != n / CLASSES ? 0 :
+				_TokenGoto<Tokens>::template next<Fail>(n / CLASSES, ClassChar::values[n % CLASSES]);
+	}
+};
+
+template<typename Tokens>
+struct _TokenLength {
+	static constexpr uint8_t at(size_t token) {
+		return _TokenCanonical<Tokens>::length(token);
+	}
+};
+
+/* 1 + the longest token ending each state, 0 if none */
+template<typename Tokens>
+struct _TokenOutput {
+	typedef _TokenCanonical<Tokens> C;
+	typedef _TokenTransition<Tokens> T;
+
+	static constexpr uint8_t _complete(size_t id, uint8_t token = 0) {
+		return token == _TokenSizes<Tokens>::COUNT ? 0 :
+				T::Canonical::values[C::Offset::values[token + 1]] == id ? token + 1 : _complete(id, token + 1);
+	}
+	static constexpr uint8_t _output(size_t id) {
+		return id == 0 ? 0 : _complete(id) != 0 ? _complete(id) : _output(T::Fail::values[id]);
+	}
+	static constexpr uint8_t at(size_t id) {
+		return _output(T::Canonical::values[id]);
+	}
+};
+
+template<typename Tokens>
+class TokenMatcher {
+
+	static const uint16_t STATES = _TokenSizes<Tokens>::STATES;
+	static const uint16_t CLASSES = _TokenClasses<Tokens>::CLASSES;
+
+	static_assert(Tokens::count() > 0 && Tokens::count() < 255, "1 to 254 tokens");
+	static_assert(STATES <= 256, "at most 255 characters in the tokens");
+
+public:
+
+	static const uint8_t NONE = 0xFF;
+
+	static uint8_t count();
+
+	static uint8_t length(uint8_t token);
+
+	/*
+	 * first occurrence of any token from offset, NONE if not found.
+	 * position is set to the index of the token in the buffer when found.
+	 */
+	template<typename Buffer>
+	static uint8_t find(const Buffer& buffer, typename Buffer::size_type* position,
+			typename Buffer::size_type offset = 0);
+
+	/* size in flash of the automaton */
+	static size_t flash_size();
+
+private:
+
+	typedef _TokenFlash<_TokenTransition<Tokens>, STATES * CLASSES> Transitions;
+	typedef _TokenFlash<_TokenClass<Tokens>, 256> Classes;
+	typedef _TokenFlash<_TokenOutput<Tokens>, STATES> Outputs;
+	typedef _TokenFlash<_TokenLength<Tokens>, _TokenSizes<Tokens>::COUNT> Lengths;
+};
+
+/*
+ * IMPLEMENTATION
+ */
+
+template<typename Tokens>
+const uint8_t TokenMatcher<Tokens>::NONE;
+
+template<typename Tokens>
+uint8_t TokenMatcher<Tokens>::count() {
+	return Tokens::count();
+}
+
+template<typename Tokens>
+uint8_t TokenMatcher<Tokens>::length(uint8_t token) {
+	return pgm_read_byte(&Lengths::values[token]);
+}
+
+template<typename Tokens>
+template<typename Buffer>
+uint8_t TokenMatcher<Tokens>::find(const Buffer& buffer, typename Buffer::size_type* position,
+		typename Buffer::size_type offset) {
+	typename Buffer::Segments segs = buffer.segments();
+	const char* from[] = { segs.first.data, segs.second.data };
+	typename Buffer::size_type lengths[] = { segs.first.length, segs.second.length };
+	typename Buffer::size_type idx = 0;
+	uint8_t state = 0;
+	for (uint8_t seg = 0; seg < 2; ++seg) {
+		const char* c = from[seg];
+		const char* last = c + lengths[seg];
+		/* skip what is before offset */
+		if (idx + lengths[seg] <= offset) {
+			idx += lengths[seg];
+			continue;
+		}
+		if (idx < offset) {
+			c += offset - idx;
+			idx = offset;
+		}
+		for (; c < last; ++c, ++idx) {
+			uint8_t k = pgm_read_byte(&Classes::values[(uint8_t) *c]);
+			state = pgm_read_byte(&Transitions::values[state * CLASSES + k]);
+			uint8_t out = pgm_read_byte(&Outputs::values[state]);
+			if (out != 0) {
+				*position = idx + 1 - length(out - 1);
+				return out - 1;
+			}
+		}
+	}
+	return NONE;
+}
+
+template<typename Tokens>
+size_t TokenMatcher<Tokens>::flash_size() {
+	return sizeof (Transitions::values) + sizeof (Classes::values) + sizeof (Outputs::values) + sizeof (Lengths::values);
+}
+
+#endif
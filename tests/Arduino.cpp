@@ -1,10 +1,17 @@
-#include <chrono>
+#include <time.h>
 
-using namespace std::chrono;
+/*
+ * Monotonic like the Arduino millis(): a wall clock jump does not fire or hold the timeouts.
+ * The coarse clock is the tick of the kernel, read without a syscall.
+ */
+#ifdef CLOCK_MONOTONIC_COARSE
+#define ARDUINO_CLOCK CLOCK_MONOTONIC_COARSE
+#else
+#define ARDUINO_CLOCK CLOCK_MONOTONIC
+#endif
 
 unsigned long millis() {
-  auto time = system_clock::now(); // get the current time
-  auto since_epoch = time.time_since_epoch(); // get the duration since epoch
-  auto millis = duration_cast<milliseconds>(since_epoch);
-  return millis.count();
+  struct timespec now;
+  clock_gettime(ARDUINO_CLOCK, &now);
+  return (unsigned long) now.tv_sec * 1000 + now.tv_nsec / 1000000;
 }
@@ -13,6 +13,10 @@ unsigned long millis();
 
 #define F(str) (char*)str
 
+// no separate flash address space on the host
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+
 //#include <RingBuffer.h>
 //#include <ATCmd.h>
 //#include <AT_CFUN.h>
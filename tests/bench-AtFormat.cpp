@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+#include <string.h>
+
+#include <Arduino.h>
+#include <RingBuffer.h>
+#include <AtFormat.h>
+
+#include "bench.h"
+
+/*
+ * "AT+CFUN=%d,%d\r\n" queued for transmission then drained: snprintf into a stack
+ * buffer and append, vs at_queue straight into the ring.
+ */
+TEST(AtFormat, bench_queue) {
+	static StringBuffer<256> tx;
+	const unsigned long ops = 2 * 1000 * 1000;
+	BENCH_REPORT("snprintf + append per command", bench_ns_per_op(ops, [&]() {
+		unsigned long sum = 0;
+		for (unsigned long i = 0; i < ops; ++i) {
+			BENCH_CLOBBER();
+			char buff[255];
+			int len = snprintf(buff, sizeof(buff), "AT+CFUN=%d,%d\r\n", (int) (i & 3), 1);
+			sum += tx.append(buff, len);
+			tx.discard(len);
+		}
+		bench_sink = sum;
+	}));
+	BENCH_REPORT("at_queue per command", bench_ns_per_op(ops, [&]() {
+		unsigned long sum = 0;
+		for (unsigned long i = 0; i < ops; ++i) {
+			BENCH_CLOBBER();
+			size_t len = at_queue(tx, "AT+CFUN=%d,%d\r\n", (int) (i & 3), 1);
+			sum += len;
+			tx.discard(len);
+		}
+		bench_sink = sum;
+	}));
+	BENCH_REPORT("at_format to ring, unchecked, per command", bench_ns_per_op(ops, [&]() {
+		unsigned long sum = 0;
+		AtRingSink<StringBuffer<256> > sink(tx);
+		for (unsigned long i = 0; i < ops; ++i) {
+			BENCH_CLOBBER();
+			size_t len = at_format(sink, "AT+CFUN=%d,%d\r\n", (int) (i & 3), 1);
+			sum += len;
+			tx.discard(len);
+		}
+		bench_sink = sum;
+	}));
+}
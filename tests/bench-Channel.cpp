@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+
+#include <Arduino.h>
+#include <Channel.h>
+
+#include "bench.h"
+
+static Channel<int, 16> g_bench_chan;
+
+COROUTINE(int, BenchProducer,
+	CORO_ARG(BenchProducer, int, count)
+	CORO_VAR(int, i)
+)
+CORO_START(BenchProducer);
+{
+	for (i = 0; i < count; ++i)
+		SEND(g_bench_chan, i);
+}
+CORO_RETURN(i);
+CORO_END();
+
+COROUTINE(int, BenchConsumer,
+	CORO_ARG(BenchConsumer, int, count)
+	CORO_VAR(int, i)
+	CORO_VAR(int, value)
+)
+CORO_START(BenchConsumer);
+{
+	for (i = 0; i < count; ++i)
+		RECV(g_bench_chan, value);
+}
+CORO_RETURN(value);
+CORO_END();
+
+/* the same consumer without the channel events: run on every pass, polling */
+COROUTINE(int, BenchPollConsumer,
+	CORO_ARG(BenchPollConsumer, int, count)
+	CORO_VAR(int, i)
+	CORO_VAR(int, value)
+)
+CORO_START(BenchPollConsumer);
+{
+	for (i = 0; i < count; ++i)
+		while (!g_bench_chan.recv(&value))
+			YIELD();
+}
+CORO_RETURN(value);
+CORO_END();
+
+static void bench_chan_clbk(uint8_t, const ICoroutine* coro) {
+	bench_sink = (unsigned long) coro;
+}
+
+/*
+ * Items through a Channel<int, 16> from a producer to a consumer, with 6 idle coroutines
+ * sleeping next to them: cost per item of the whole scheduling.
+ */
+TEST(Channel, bench_pipeline) {
+	const int count = 200 * 1000;
+	ICoroutine* coroutines[8];
+	for (int i = 2; i < 8; ++i)
+		coroutines[i] = new Delay(3600UL * 1000);
+	coroutines[0] = (new BenchConsumer(3600UL * 1000))->set_count(count);
+	coroutines[1] = (new BenchProducer(3600UL * 1000))->set_count(count);
+	BENCH_REPORT("SEND/RECV per item", bench_ns_per_op(count, [&]() {
+		unsigned long next_wake;
+		while (coroutines[0] != nullptr || coroutines[1] != nullptr)
+			schedule_coro_once(coroutines, 8, bench_chan_clbk, &next_wake);
+	}));
+	coroutines[0] = (new BenchPollConsumer(3600UL * 1000))->set_count(count);
+	coroutines[1] = (new BenchProducer(3600UL * 1000))->set_count(count);
+	BENCH_REPORT("SEND/polling consumer per item", bench_ns_per_op(count, [&]() {
+		unsigned long next_wake;
+		while (coroutines[0] != nullptr || coroutines[1] != nullptr)
+			schedule_coro_once(coroutines, 8, bench_chan_clbk, &next_wake);
+	}));
+	for (int i = 2; i < 8; ++i)
+		delete coroutines[i];
+}
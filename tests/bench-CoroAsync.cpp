@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+#include <stdio.h>
+
+#include <Arduino.h>
+#include <CoroAsync.h>
+
+#include "bench.h"
+
+COROUTINE(int, BenchCount,
+	CORO_ARG(BenchCount, int, limit)
+	CORO_VAR(int, count)
+)
+CORO_START(BenchCount);
+{
+	count = 0;
+	while (count < limit) {
+		++count;
+		YIELD();
+	}
+}
+CORO_RETURN(count);
+CORO_END();
+
+COROUTINE(int, BenchNested,
+	CORO_ARG(BenchNested, int, limit)
+)
+CORO_START(BenchNested);
+{
+	AWAIT((new BenchCount())->set_limit(limit));
+}
+CORO_RETURN(0);
+CORO_END();
+
+static CoroAsync<int> bench_count(int limit) {
+	int count = 0;
+	while (count < limit) {
+		++count;
+		co_await coro_yield();
+	}
+	co_return count;
+}
+
+static CoroAsync<int> bench_nested(int limit) {
+	co_return co_await bench_count(limit);
+}
+
+/* cost of one run(), that is one resume up to the next yield */
+TEST(CoroAsync, bench_resume) {
+	const int limit = 5 * 1000 * 1000;
+	BenchCount macro;
+	macro.set_limit(limit);
+	BENCH_REPORT("COROUTINE() resume", bench_ns_per_op(limit, [&]() {
+		while (macro.live())
+			macro.run();
+	}));
+	CoroAsync<int> async = bench_count(limit);
+	BENCH_REPORT("CoroAsync resume", bench_ns_per_op(limit, [&]() {
+		while (async.live())
+			async.run();
+	}));
+	bench_sink = macro.result() + async.result();
+}
+
+/* run() of a coroutine awaiting a sub coroutine */
+TEST(CoroAsync, bench_resume_nested) {
+	const int limit = 5 * 1000 * 1000;
+	BenchNested macro;
+	macro.set_limit(limit);
+	BENCH_REPORT("COROUTINE() AWAIT resume", bench_ns_per_op(limit, [&]() {
+		while (macro.live())
+			macro.run();
+	}));
+	CoroAsync<int> async = bench_nested(limit);
+	BENCH_REPORT("CoroAsync co_await resume", bench_ns_per_op(limit, [&]() {
+		while (async.live())
+			async.run();
+	}));
+	bench_sink = macro.result() + async.result();
+}
+
+/* the COROUTINE() state is the object, CoroAsync adds its frame from the arena */
+TEST(CoroAsync, bench_memory) {
+	CoroArena::reset_stats();
+	{
+		CoroAsync<int> async = bench_count(1);
+	}
+	printf("[   BENCH  ] %-40s %10u bytes\n", "COROUTINE() object", (unsigned) sizeof(BenchCount));
+	printf("[   BENCH  ] %-40s %10u bytes\n", "CoroAsync object", (unsigned) sizeof(CoroAsync<int>));
+	printf("[   BENCH  ] %-40s %10u bytes\n", "CoroAsync frame", (unsigned) CoroArena::largest());
+	printf("[   BENCH  ] %-40s %10u bytes\n", "CoroAsync arena block", (unsigned) CORO_ARENA_BLOCK_SIZE);
+}
@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+#include <string.h>
+#include <thread>
+
+#include <Arduino.h>
+#include <CoroCtxScheduler.h>
+
+#include "bench.h"
+
+CORO_CTX(int, Step,
+	int limit;
+	int count;
+	uint32_t state;
+)
+CORO_BEGIN_CTX(Step)
+{
+	for (ctx.count = 0; ctx.count < ctx.limit; ++ctx.count) {
+		// a bit of work per run, like parsing a modem line
+		for (int i = 0; i < 16; ++i)
+			ctx.state = ctx.state * 1103515245 + 12345;
+		YIELD_CTX();
+	}
+}
+CORO_RETURN_CTX(ctx.state);
+CORO_END_CTX()
+
+/*
+ * 16k coroutines of 100 runs each, from 1 thread to all the cores (and twice that).
+ */
+TEST(CoroCtxScheduler, bench_scaling) {
+	const int count = 16 * 1024;
+	static StepCtx ctx[count];
+	unsigned cores = std::thread::hardware_concurrency();
+	for (unsigned threads = 1; threads <= 2 * cores || threads == 1; threads *= 2) {
+		CoroCtxScheduler scheduler(threads);
+		for (int i = 0; i < count; ++i) {
+			CORO_INIT(ctx[i], TIMEOUT_MS * 100);
+			ctx[i].limit = 100;
+			ctx[i].state = i;
+			CORO_SPAWN(scheduler, Step, ctx[i]);
+		}
+		char name[64];
+		snprintf(name, sizeof(name), "%u threads on %u cores, per run", threads, cores);
+		BENCH_REPORT(name, bench_ns_per_op(count * 101UL, [&]() {
+			scheduler.run();
+		}));
+		bench_sink = scheduler.steals();
+	}
+}
@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include <chrono>
+
+#include <Arduino.h>
+#include <Coroutine.h>
+
+#include "bench.h"
+
+/*
+ * AWAIT(new Delay()) then delete: the pool vs the heap (::new bypasses the pool).
+ * A few coroutines are kept alive so that the heap is not a single reused chunk.
+ */
+TEST(Coroutine, bench_new_delete) {
+	const unsigned long ops = 2 * 1000 * 1000;
+	ICoroutine* live[4];
+	BENCH_REPORT("::new/::delete Delay", bench_ns_per_op(ops, [&]() {
+		for (unsigned long i = 0; i < ops; ++i) {
+			ICoroutine*& slot = live[i & 3];
+			if (i >= 4)
+				::delete slot;
+			slot = ::new Delay(0);
+			BENCH_CLOBBER();
+		}
+		for (int i = 0; i < 4; ++i)
+			::delete live[i];
+	}));
+	BENCH_REPORT("pool new/delete Delay", bench_ns_per_op(ops, [&]() {
+		for (unsigned long i = 0; i < ops; ++i) {
+			ICoroutine*& slot = live[i & 3];
+			if (i >= 4)
+				delete slot;
+			slot = new Delay(0);
+			BENCH_CLOBBER();
+		}
+		for (int i = 0; i < 4; ++i)
+			delete live[i];
+	}));
+	bench_sink = CoroPool::peak();
+}
+
+COROUTINE(int, BenchSpin,
+	CORO_VAR(int, count)
+)
+CORO_START(BenchSpin);
+{
+	while (true) {
+		++count;
+		YIELD();
+	}
+}
+CORO_RETURN(count);
+CORO_END();
+
+static void bench_clbk(uint8_t, const ICoroutine*) {
+}
+
+/* a pass of schedule_coro_once over 8 coroutines, per coroutine run: see bench_static_scheduler */
+TEST(Coroutine, bench_schedule_once) {
+	const unsigned long passes = 1000 * 1000;
+	ICoroutine* coroutines[8];
+	for (int i = 0; i < 8; ++i)
+		coroutines[i] = new BenchSpin(3600UL * 1000);
+	BENCH_REPORT("schedule_coro_once per run", bench_ns_per_op(passes * 8, [&]() {
+		unsigned long next_wake;
+		unsigned long live = 0;
+		for (unsigned long p = 0; p < passes; ++p)
+			live += schedule_coro_once(coroutines, 8, bench_clbk, &next_wake);
+		bench_sink = live;
+	}));
+	for (int i = 0; i < 8; ++i)
+		delete coroutines[i];
+}
+
+/* one clock read: the former system_clock millis(), millis() and the tick of a pass */
+TEST(Coroutine, bench_clock) {
+	const unsigned long ops = 5 * 1000 * 1000;
+	BENCH_REPORT("system_clock ms", bench_ns_per_op(ops, [&]() {
+		unsigned long sum = 0;
+		for (unsigned long i = 0; i < ops; ++i)
+			sum += std::chrono::duration_cast<std::chrono::milliseconds>(
+					std::chrono::system_clock::now().time_since_epoch()).count();
+		bench_sink = sum;
+	}));
+	BENCH_REPORT("millis()", bench_ns_per_op(ops, [&]() {
+		unsigned long sum = 0;
+		for (unsigned long i = 0; i < ops; ++i)
+			sum += millis();
+		bench_sink = sum;
+	}));
+	CoroPass pass;
+	BENCH_REPORT("coro_now() in a pass", bench_ns_per_op(ops, [&]() {
+		unsigned long sum = 0;
+		for (unsigned long i = 0; i < ops; ++i) {
+			sum += coro_now();
+			BENCH_CLOBBER();
+		}
+		bench_sink = sum;
+	}));
+}
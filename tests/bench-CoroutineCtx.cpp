@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+#include <string.h>
+
+#include <Arduino.h>
+#include <CoroutineCtx.h>
+
+#include "bench.h"
+
+CORO_CTX(bool, Idle, )
+CORO_BEGIN_CTX(Idle)
+{
+	while (true) {
+		YIELD_CTX();
+	}
+}
+CORO_END_CTX()
+
+/*
+ * 10k coroutines far from their timeout, all run at each tick: each checking millis()
+ * vs the scheduler advancing a timer wheel once per tick.
+ */
+TEST(CoroutineCtx, bench_timeouts) {
+	const int count = 10000;
+	const unsigned long ticks = 200;
+	static IdleCtx ctx[count];
+	for (int i = 0; i < count; ++i) {
+		CORO_INIT(ctx[i], 3600UL * 1000 + i);
+	}
+	BENCH_REPORT("self check per coroutine run", bench_ns_per_op(ticks * count, [&]() {
+		for (unsigned long t = 0; t < ticks; ++t)
+			for (int i = 0; i < count; ++i)
+				Idle(ctx[i]);
+	}));
+	static CoroTimerWheel<> wheel;
+	for (int i = 0; i < count; ++i) {
+		CORO_INIT_WHEEL(ctx[i], 3600UL * 1000 + i, wheel);
+	}
+	BENCH_REPORT("timer wheel per coroutine run", bench_ns_per_op(ticks * count, [&]() {
+		unsigned long sum = 0;
+		for (unsigned long t = 0; t < ticks; ++t) {
+			sum += wheel.advance();
+			for (int i = 0; i < count; ++i)
+				Idle(ctx[i]);
+		}
+		bench_sink = sum;
+	}));
+	// expiry cost: all expiring over one second
+	for (int i = 0; i < count; ++i) {
+		CORO_INIT(ctx[i], i / 10);
+		ctx[i]._start = 0;
+	}
+	BENCH_REPORT("timer wheel add + expire per coroutine", bench_ns_per_op(count, [&]() {
+		CoroTimerWheel<> expiring(0);
+		for (int i = 0; i < count; ++i)
+			expiring.add(ctx[i]);
+		unsigned long sum = 0;
+		for (unsigned long now = 0; now <= 1001; ++now)
+			sum += expiring.advance(now);
+		bench_sink = sum;
+	}));
+}
+
+CORO_CTX(int, Spin,
+	int count;
+)
+CORO_BEGIN_CTX(Spin)
+{
+	while (true) {
+		++ctx.count;
+		YIELD_CTX();
+	}
+}
+CORO_END_CTX()
+
+template<typename Ctx, void (*Fct)(Ctx&)>
+void bench_thunk(CoroCtx& ctx) {
+	Fct((Ctx&) ctx);
+}
+
+struct BenchClbk {
+	template<typename Ctx>
+	void operator()(uint8_t, const Ctx& ctx) {
+		bench_sink = CORO_RESULT(ctx);
+	}
+};
+
+/*
+ * A pass over 8 coroutines, cost per coroutine run: through a table of function pointers vs
+ * CoroStaticScheduler. The virtual run() of schedule_coro_once is in bench-Coroutine.cpp.
+ */
+TEST(CoroutineCtx, bench_static_scheduler) {
+	const unsigned long passes = 1000 * 1000;
+	static SpinCtx spin[4];
+	static IdleCtx idle[4];
+	static CoroTimerWheel<> wheel; // never advanced: no millis() in the runs, only the dispatch
+	for (int i = 0; i < 4; ++i) {
+		CORO_INIT_WHEEL(spin[i], 3600UL * 1000, wheel);
+		CORO_INIT_WHEEL(idle[i], 3600UL * 1000, wheel);
+	}
+	struct Entry {
+		CoroCtx* ctx;
+		void (*fct)(CoroCtx&);
+	} table[8];
+	for (int i = 0; i < 4; ++i) {
+		table[2 * i] = {&spin[i], bench_thunk<SpinCtx, Spin>};
+		table[2 * i + 1] = {&idle[i], bench_thunk<IdleCtx, Idle>};
+	}
+	BENCH_REPORT("function pointer table per run", bench_ns_per_op(passes * 8, [&]() {
+		for (unsigned long p = 0; p < passes; ++p)
+			for (int i = 0; i < 8; ++i)
+				if (table[i].ctx->_live)
+					table[i].fct(*table[i].ctx);
+	}));
+	auto scheduler = make_coro_scheduler(CORO_BIND(Spin, spin[0]), CORO_BIND(Idle, idle[0]),
+			CORO_BIND(Spin, spin[1]), CORO_BIND(Idle, idle[1]), CORO_BIND(Spin, spin[2]),
+			CORO_BIND(Idle, idle[2]), CORO_BIND(Spin, spin[3]), CORO_BIND(Idle, idle[3]));
+	BenchClbk clbk;
+	BENCH_REPORT("CoroStaticScheduler per run", bench_ns_per_op(passes * 8, [&]() {
+		unsigned long live = 0;
+		for (unsigned long p = 0; p < passes; ++p)
+			live += scheduler.run_once(clbk);
+		bench_sink = live;
+	}));
+	printf("[   BENCH  ] %-40s %10u bytes\n", "CoroStaticScheduler for 8", (unsigned) sizeof(scheduler));
+}
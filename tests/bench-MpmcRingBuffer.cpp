@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <Arduino.h>
+#include <RingBuffer.h>
+#include <MpmcRingBuffer.h>
+
+#include "bench.h"
+
+static const unsigned long ITEMS = 1000 * 1000;
+
+/* the ad-hoc alternative: a RingBuffer guarded by a lock */
+template<uint16_t Size, typename T>
+class LockedRingBuffer {
+public:
+	uint16_t append(const T& c) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _buffer.append(c);
+	}
+	uint16_t read(T* dst, uint16_t n) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _buffer.read(dst, n);
+	}
+private:
+	std::mutex _mutex;
+	RingBuffer<Size, T> _buffer;
+};
+
+/*
+ * ns per item going through the queue. With a single thread, it pushes and pops in turn,
+ * otherwise half of the threads produce and the other half consume.
+ */
+template<typename Queue>
+static double contention(Queue& queue, unsigned threads) {
+	return bench_ns_per_op(ITEMS, [&]() {
+		if (threads == 1) {
+			unsigned long sum = 0, value;
+			for (unsigned long i = 0; i < ITEMS; ++i) {
+				queue.append(i);
+				queue.read(&value, 1);
+				sum += value;
+			}
+			bench_sink = sum;
+			return;
+		}
+		unsigned pairs = threads / 2;
+		unsigned long per_thread = ITEMS / pairs;
+		std::vector<std::thread> workers;
+		for (unsigned t = 0; t < pairs; ++t) {
+			workers.push_back(std::thread([&queue, per_thread]() {
+				for (unsigned long i = 0; i < per_thread; )
+					if (queue.append(i))
+						++i;
+					else
+						std::this_thread::yield();
+			}));
+			workers.push_back(std::thread([&queue, per_thread]() {
+				unsigned long sum = 0, value;
+				for (unsigned long i = 0; i < per_thread; )
+					if (queue.read(&value, 1)) {
+						sum += value;
+						++i;
+					} else
+						std::this_thread::yield();
+				bench_sink = sum;
+			}));
+		}
+		for (auto& w : workers)
+			w.join();
+	});
+}
+
+TEST(MpmcRingBuffer, bench_contention) {
+	char name[64];
+	for (unsigned threads = 1; threads <= 16; threads *= 2) {
+		LockedRingBuffer<256, unsigned long> locked;
+		MpmcRingBuffer<256, unsigned long> mpmc;
+		snprintf(name, sizeof (name), "locked RingBuffer, %u threads", threads);
+		BENCH_REPORT(name, contention(locked, threads));
+		snprintf(name, sizeof (name), "MpmcRingBuffer, %u threads", threads);
+		BENCH_REPORT(name, contention(mpmc, threads));
+	}
+}
@@ -0,0 +1,326 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+
+#include <Arduino.h>
+#include <RingBuffer.h>
+
+#include "bench.h"
+
+static const unsigned long OPS = 10 * 1000 * 1000;
+
+/*
+ * Serial ISR like usage: bytes are pushed one by one and drained by the main loop.
+ * 255 uses the modulo arithmetic, 256 the mask one.
+ */
+template<uint32_t Size, typename Overflow>
+static double append_pop(StringBuffer<Size, Overflow>& buff) {
+	return bench_ns_per_op(OPS, [&]() {
+		unsigned long sum = 0;
+		for (unsigned long i = 0; i < OPS; ++i) {
+			buff.append((char)i);
+			if (buff.length() > Size / 2)
+				sum += buff.pop_first();
+		}
+		bench_sink = sum;
+	});
+}
+
+template<uint32_t Size>
+static double random_access(StringBuffer<Size>& buff) {
+	while (!buff.full())
+		buff.append('a');
+	// make the content wrap around the end of the array
+	buff.pop_firsts(Size / 2);
+	while (!buff.full())
+		buff.append('b');
+	return bench_ns_per_op(OPS, [&]() {
+		unsigned long sum = 0;
+		for (unsigned long i = 0; i < OPS / Size; ++i)
+			for (uint16_t j = 0; j < Size; ++j)
+				sum += buff[j];
+		bench_sink = sum;
+	});
+}
+
+TEST(RingBuffer, bench_append_pop) {
+	StringBuffer<255> modulo;
+	StringBuffer<256> mask;
+	BENCH_REPORT("append/pop_first modulo <255>", append_pop(modulo));
+	BENCH_REPORT("append/pop_first mask <256>", append_pop(mask));
+}
+
+TEST(RingBuffer, bench_operator_at) {
+	StringBuffer<255> modulo;
+	StringBuffer<256> mask;
+	BENCH_REPORT("operator[] modulo <255>", random_access(modulo));
+	BENCH_REPORT("operator[] mask <256>", random_access(mask));
+}
+
+/*
+ * Serial ingestion and response draining: chunks of CHUNK bytes going through the
+ * buffer, byte per byte versus append(src, n) / read(dst, n).
+ */
+static const uint16_t CHUNK = 200;
+
+TEST(RingBuffer, bench_bulk) {
+	StringBuffer<256> buff;
+	char chunk[CHUNK];
+	memset(chunk, 'A', CHUNK);
+	BENCH_REPORT("append(c)/pop_first() per byte", bench_ns_per_op(OPS, [&]() {
+		unsigned long sum = 0;
+		for (unsigned long i = 0; i < OPS / CHUNK; ++i) {
+			for (uint16_t j = 0; j < CHUNK; ++j)
+				buff.append(chunk[j]);
+			for (uint16_t j = 0; j < CHUNK; ++j)
+				chunk[j] = buff.pop_first();
+			sum += chunk[i % CHUNK];
+		}
+		bench_sink = sum;
+	}));
+	BENCH_REPORT("append(src, n)/read(dst, n) per byte", bench_ns_per_op(OPS, [&]() {
+		unsigned long sum = 0;
+		for (unsigned long i = 0; i < OPS / CHUNK; ++i) {
+			buff.append(chunk, CHUNK);
+			buff.read(chunk, CHUNK);
+			sum += chunk[i % CHUNK];
+		}
+		bench_sink = sum;
+	}));
+}
+
+/*
+ * Memory overhead of an instantiation, compared to the previous four uint16_t
+ * (start, end, length and capacity).
+ */
+#define SIZEOF_REPORT(type, size) \
+	printf("[   BENCH  ] %-40s %6u bytes overhead (was 4 x uint16_t)\n", #type, (unsigned)(sizeof (type) - (size)))
+
+TEST(RingBuffer, sizeof_report) {
+	SIZEOF_REPORT(StringBuffer<64>, 64);
+	SIZEOF_REPORT(StringBuffer<255>, 255);
+	SIZEOF_REPORT(StringBuffer<256>, 256);
+	SIZEOF_REPORT(StringBuffer<1000>, 1000);
+	SIZEOF_REPORT(StringBuffer<100000>, 100000);
+}
+
+/*
+ * Appending byte per byte into a buffer that is always full, like a capture of the modem
+ * traffic nobody drains, then the same while it is drained.
+ */
+template<typename Buffer>
+static double append_full(Buffer& buff) {
+	while (!buff.full())
+		buff.append('a');
+	return bench_ns_per_op(OPS, [&]() {
+		unsigned long sum = 0;
+		for (unsigned long i = 0; i < OPS; ++i)
+			sum += buff.append((char)i);
+		bench_sink = sum;
+	});
+}
+
+TEST(RingBuffer, bench_overflow_policies) {
+	StringBuffer<256, RingDropNew> drop;
+	StringBuffer<256, RingOverwriteOld> overwrite;
+	StringBuffer<256, RingReportOverflow> report;
+	BENCH_REPORT("append when full, drop new", append_full(drop));
+	BENCH_REPORT("append when full, overwrite old", append_full(overwrite));
+	BENCH_REPORT("append when full, report overflow", append_full(report));
+	drop.clear();
+	overwrite.clear();
+	report.clear();
+	BENCH_REPORT("append/pop_first, drop new", append_pop(drop));
+	BENCH_REPORT("append/pop_first, overwrite old", append_pop(overwrite));
+	BENCH_REPORT("append/pop_first, report overflow", append_pop(report));
+}
+
+/*
+ * Scanning a wrapped buffer through operator[] (bounds check and index arithmetic per
+ * element) versus the segment iterators.
+ */
+TEST(RingBuffer, bench_iterators) {
+	StringBuffer<255> buff;
+	std::string fill(200, 'a');
+	buff.append(fill.c_str());
+	buff.pop_firsts(200);
+	buff.append(std::string(250, 'b').c_str());
+	BENCH_REPORT("scan with operator[] <255>", bench_ns_per_op(OPS, [&]() {
+		unsigned long sum = 0;
+		for (unsigned long i = 0; i < OPS / 250; ++i)
+			for (uint16_t j = 0; j < buff.length(); ++j)
+				sum += buff[j];
+		bench_sink = sum;
+	}));
+	BENCH_REPORT("scan with const_iterator <255>", bench_ns_per_op(OPS, [&]() {
+		unsigned long sum = 0;
+		for (unsigned long i = 0; i < OPS / 250; ++i)
+			for (char c : buff)
+				sum += c;
+		bench_sink = sum;
+	}));
+	const char token[] = "ba";
+	BENCH_REPORT("std::find with const_iterator <255>", bench_ns_per_op(OPS, [&]() {
+		unsigned long sum = 0;
+		for (unsigned long i = 0; i < OPS / 250; ++i)
+			sum += std::find(buff.begin(), buff.end(), 'c').index();
+		bench_sink = sum;
+	}));
+	BENCH_REPORT("std::search with const_iterator <255>", bench_ns_per_op(OPS, [&]() {
+		unsigned long sum = 0;
+		for (unsigned long i = 0; i < OPS / 250; ++i)
+			sum += std::search(buff.begin(), buff.end(), token, token + 2).index();
+		bench_sink = sum;
+	}));
+}
+
+/*
+ * Looking for "OK\r\n" at the end of a wrapped buffer full of "+CSQ: 23,0\r\n" lines, with
+ * index_of (memchr/memcmp per segment) and with a naive search over the iterators.
+ */
+template<uint32_t Size>
+static void bench_index_of() {
+	static StringBuffer<Size> buff;
+	const char* line = "+CSQ: 23,0\r\n";
+	buff.append(std::string(Size / 2, '-').c_str());
+	buff.pop_firsts(Size / 2);
+	while (buff.length() + strlen(line) + 4 <= Size)
+		buff.append(line);
+	buff.append("OK\r\n");
+	unsigned long ops = 100 * 1000 * 1000;
+	unsigned long loops = ops / Size;
+	char name[64];
+	snprintf(name, sizeof (name), "index_of per byte, StringBuffer<%u>", (unsigned) Size);
+	BENCH_REPORT(name, bench_ns_per_op(ops, [&]() {
+		unsigned long sum = 0;
+		for (unsigned long i = 0; i < loops; ++i) {
+			BENCH_CLOBBER();
+			sum += buff.index_of("OK\r\n");
+		}
+		bench_sink = sum;
+	}));
+	const char token[] = "OK\r\n";
+	snprintf(name, sizeof (name), "naive search per byte, StringBuffer<%u>", (unsigned) Size);
+	BENCH_REPORT(name, bench_ns_per_op(ops, [&]() {
+		unsigned long sum = 0;
+		for (unsigned long i = 0; i < loops; ++i) {
+			BENCH_CLOBBER();
+			auto it = buff.begin(), last = buff.end() - 4;
+			for (; it <= last; ++it) {
+				auto c = it;
+				unsigned j = 0;
+				while (j < 4 && *c == token[j]) {
+					++c;
+					++j;
+				}
+				if (j == 4)
+					break;
+			}
+			sum += it.index();
+		}
+		bench_sink = sum;
+	}));
+}
+
+TEST(StringBuffer, bench_index_of) {
+	bench_index_of<64>();
+	bench_index_of<256>();
+	bench_index_of<1024>();
+	bench_index_of<4096>();
+	bench_index_of<16384>();
+	bench_index_of<65536>();
+}
+
+/*
+ * Parsing a stream of "+CFUN: 1" events the way the AT parsers did (pop_until the event,
+ * pop_while the spaces, read the value, pop_until "\r\n") vs one find_line per event.
+ * The buffer is refilled with a single bulk append.
+ */
+TEST(StringBuffer, bench_next_line) {
+	static StringBuffer<256> buff;
+	std::string events;
+	while (events.size() + 12 <= buff.capacity())
+		events += "\r\n+CFUN: 1\r\n";
+	const unsigned long ops = 5 * 1000 * 1000;
+	BENCH_REPORT("pop_until/pop_while parse per event", bench_ns_per_op(ops, [&]() {
+		unsigned long sum = 0;
+		for (unsigned long i = 0; i < ops; ++i) {
+			if (buff.empty())
+				buff.append(events.data(), events.size());
+			BENCH_CLOBBER();
+			buff.pop_until("+CFUN:");
+			buff.pop_while(' ');
+			sum += buff[0];
+			buff.pop_until("\r\n");
+		}
+		bench_sink = sum;
+	}));
+	buff.clear();
+	BENCH_REPORT("find_line parse per event", bench_ns_per_op(ops, [&]() {
+		unsigned long sum = 0;
+		StringBuffer<256>::Line line;
+		for (unsigned long i = 0; i < ops; ++i) {
+			if (buff.empty())
+				buff.append(events.data(), events.size());
+			BENCH_CLOBBER();
+			buff.find_line("+CFUN:", &line);
+			sum += line.substr(6).trim_left()[0];
+			buff.consume(line);
+		}
+		bench_sink = sum;
+	}));
+}
+
+/*
+ * "+CSQ: 23,0" values: parsed in place on the line view vs copied out and given to sscanf,
+ * or to strtol.
+ */
+TEST(StringBuffer, bench_parse_numbers) {
+	static StringBuffer<64> buff;
+	buff.append("------------------------------------------------------");
+	buff.pop_firsts(54);
+	buff.append("+CSQ: 23,0\r\n");
+	StringBuffer<64>::Line line;
+	buff.next_line(&line);
+	const unsigned long ops = 10 * 1000 * 1000;
+	BENCH_REPORT("view parse_uint x2 per line", bench_ns_per_op(ops, [&]() {
+		unsigned long sum = 0;
+		for (unsigned long i = 0; i < ops; ++i) {
+			BENCH_CLOBBER();
+			StringBuffer<64>::Line value = line.substr(5).trim_left(), field;
+			uint16_t pos = 0;
+			uint32_t rssi = 0, ber = 0;
+			value.next_field(&pos, &field);
+			field.parse_uint(&rssi);
+			value.next_field(&pos, &field);
+			field.parse_uint(&ber);
+			sum += rssi + ber;
+		}
+		bench_sink = sum;
+	}));
+	BENCH_REPORT("copy + sscanf per line", bench_ns_per_op(ops, [&]() {
+		unsigned long sum = 0;
+		char copy[16];
+		for (unsigned long i = 0; i < ops; ++i) {
+			BENCH_CLOBBER();
+			std::copy(line.begin(), line.end(), copy);
+			copy[line.length()] = '\0';
+			unsigned rssi = 0, ber = 0;
+			sscanf(copy, "+CSQ: %u,%u", &rssi, &ber);
+			sum += rssi + ber;
+		}
+		bench_sink = sum;
+	}));
+	BENCH_REPORT("copy + strtol x2 per line", bench_ns_per_op(ops, [&]() {
+		unsigned long sum = 0;
+		char copy[16];
+		for (unsigned long i = 0; i < ops; ++i) {
+			BENCH_CLOBBER();
+			std::copy(line.begin(), line.end(), copy);
+			copy[line.length()] = '\0';
+			char* end;
+			sum += strtol(copy + 6, &end, 10);
+			sum += strtol(end + 1, nullptr, 10);
+		}
+		bench_sink = sum;
+	}));
+}
@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+#include <string.h>
+
+#include <Arduino.h>
+#include <RingBuffer.h>
+#include <SearchCursor.h>
+
+#include "bench.h"
+
+/*
+ * A +CMGL listing arriving 16 bytes at a time, the end of the response being polled
+ * after each chunk: index_of from the start vs the cursor.
+ */
+template<uint32_t Size>
+static void bench_poll() {
+	static StringBuffer<Size> buff;
+	std::string listing;
+	while (listing.size() + 64 < Size)
+		listing += "+CMGL: 1,\"REC READ\",\"+33600000000\"\r\n";
+	listing += "\r\nOK\r\n";
+	const unsigned long responses = 20 * 1000 * 1000 / Size;
+	const unsigned long ops = responses * listing.size();
+	char name[64];
+	snprintf(name, sizeof (name), "index_of each poll per byte, %u B", (unsigned) Size);
+	BENCH_REPORT(name, bench_ns_per_op(ops, [&]() {
+		unsigned long sum = 0;
+		for (unsigned long i = 0; i < responses; ++i) {
+			buff.clear();
+			for (size_t sent = 0; sent < listing.size(); sent += 16) {
+				buff.append(listing.data() + sent, listing.size() - sent < 16 ? listing.size() - sent : 16);
+				BENCH_CLOBBER();
+				sum += buff.index_of("OK\r\n");
+			}
+		}
+		bench_sink = sum;
+	}));
+	snprintf(name, sizeof (name), "SearchCursor each poll per byte, %u B", (unsigned) Size);
+	BENCH_REPORT(name, bench_ns_per_op(ops, [&]() {
+		unsigned long sum = 0;
+		for (unsigned long i = 0; i < responses; ++i) {
+			buff.clear();
+			SearchCursor<StringBuffer<Size> > ok(buff, "OK\r\n");
+			for (size_t sent = 0; sent < listing.size(); sent += 16) {
+				buff.append(listing.data() + sent, listing.size() - sent < 16 ? listing.size() - sent : 16);
+				BENCH_CLOBBER();
+				sum += ok.poll();
+			}
+		}
+		bench_sink = sum;
+	}));
+}
+
+TEST(SearchCursor, bench_poll) {
+	bench_poll<256>();
+	bench_poll<1024>();
+	bench_poll<4096>();
+	bench_poll<16384>();
+}
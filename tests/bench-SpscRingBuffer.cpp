@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+#include <mutex>
+#include <thread>
+
+#include <Arduino.h>
+#include <RingBuffer.h>
+#include <SpscRingBuffer.h>
+
+#include "bench.h"
+
+static const unsigned long BYTES = 20 * 1000 * 1000;
+
+/* the alternative to SpscRingBuffer: a plain StringBuffer guarded by a lock */
+template<uint16_t Size>
+class LockedStringBuffer {
+public:
+	uint16_t append(char c) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _buffer.append(c);
+	}
+	uint16_t append(const char* src, uint16_t n) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _buffer.append(src, n);
+	}
+	char pop_first() {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _buffer.pop_first();
+	}
+	uint16_t read(char* dst, uint16_t n) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _buffer.read(dst, n);
+	}
+private:
+	std::mutex _mutex;
+	StringBuffer<Size> _buffer;
+};
+
+/* bytes pushed one by one, like an RX interrupt, and drained in chunks by the loop */
+template<typename Buffer>
+static double throughput(Buffer& buff, uint16_t chunk) {
+	return 1e9 / bench_ns_per_op(BYTES, [&]() {
+		std::thread producer([&]() {
+			char src[256] = { 0 };
+			for (unsigned long i = 0; i < BYTES; ) {
+				uint16_t count = chunk == 1 ? buff.append((char)i) : buff.append(src, BYTES - i < chunk ? BYTES - i : chunk);
+				if (count == 0)
+					std::this_thread::yield();
+				i += count;
+			}
+		});
+		char dst[256];
+		unsigned long sum = 0;
+		for (unsigned long i = 0; i < BYTES; ) {
+			uint16_t count = buff.read(dst, sizeof (dst));
+			if (count == 0)
+				std::this_thread::yield();
+			sum += count ? dst[0] : 0;
+			i += count;
+		}
+		producer.join();
+		bench_sink = sum;
+	});
+}
+
+TEST(SpscRingBuffer, bench_throughput) {
+	LockedStringBuffer<1024> locked;
+	SpscRingBuffer<1024, char> spsc;
+	BENCH_REPORT_THROUGHPUT("locked StringBuffer, 1 byte appends", throughput(locked, 1));
+	BENCH_REPORT_THROUGHPUT("SpscRingBuffer, 1 byte appends", throughput(spsc, 1));
+	BENCH_REPORT_THROUGHPUT("locked StringBuffer, 64 bytes appends", throughput(locked, 64));
+	BENCH_REPORT_THROUGHPUT("SpscRingBuffer, 64 bytes appends", throughput(spsc, 64));
+}
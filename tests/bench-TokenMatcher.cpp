@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+#include <string.h>
+
+#include <Arduino.h>
+#include <RingBuffer.h>
+#include <TokenMatcher.h>
+
+#include "bench.h"
+
+TOKEN_TABLE(Tokens2, "OK\r\n", "ERROR\r\n")
+TOKEN_TABLE(Tokens4, "OK\r\n", "ERROR\r\n", "+CFUN:", "+CPIN:")
+TOKEN_TABLE(Tokens8, "OK\r\n", "ERROR\r\n", "+CFUN:", "+CPIN:", "+DTMF:", "+CREG:", "+CGREG:", "+CSQ:")
+TOKEN_TABLE(Tokens16, "OK\r\n", "ERROR\r\n", "+CFUN:", "+CPIN:", "+DTMF:", "+CREG:", "+CGREG:", "+CSQ:",
+		"RING\r\n", "NO CARRIER\r\n", "+CMTI:", "+CLIP:", "+CME ERROR:", "+CMS ERROR:", "BUSY\r\n", "NO ANSWER\r\n")
+
+/*
+ * Earliest token of a table in a 1 KB buffer of unrelated lines, the answer being at the end:
+ * single pass of the automaton vs one index_of per token.
+ */
+template<typename Tokens>
+static void bench_tokens() {
+	static StringBuffer<1024> buff;
+	const char* line = "+CBC: 0,87,4012\r\n";
+	buff.clear();
+	buff.append(std::string(512, '-').c_str());
+	buff.pop_firsts(512);
+	while (buff.length() + strlen(line) + 4 <= buff.capacity())
+		buff.append(line);
+	buff.append("OK\r\n");
+	unsigned long ops = 100 * 1000 * 1000;
+	unsigned long loops = ops / buff.length();
+	char name[64];
+	snprintf(name, sizeof (name), "TokenMatcher per byte, %u tokens", (unsigned) Tokens::count());
+	BENCH_REPORT(name, bench_ns_per_op(ops, [&]() {
+		unsigned long sum = 0;
+		uint16_t pos;
+		for (unsigned long i = 0; i < loops; ++i) {
+			BENCH_CLOBBER();
+			sum += TokenMatcher<Tokens>::find(buff, &pos) + pos;
+		}
+		bench_sink = sum;
+	}));
+	snprintf(name, sizeof (name), "index_of per token per byte, %u tokens", (unsigned) Tokens::count());
+	BENCH_REPORT(name, bench_ns_per_op(ops, [&]() {
+		unsigned long sum = 0;
+		for (unsigned long i = 0; i < loops; ++i) {
+			BENCH_CLOBBER();
+			uint16_t first = StringBuffer<1024>::END;
+			for (uint8_t t = 0; t < Tokens::count(); ++t) {
+				uint16_t pos = buff.index_of(Tokens::token(t));
+				if (pos < first)
+					first = pos;
+			}
+			sum += first;
+		}
+		bench_sink = sum;
+	}));
+}
+
+TEST(TokenMatcher, bench_tokens) {
+	bench_tokens<Tokens2>();
+	bench_tokens<Tokens4>();
+	bench_tokens<Tokens8>();
+	bench_tokens<Tokens16>();
+	printf("[   BENCH  ] flash: %u bytes for 2 tokens, %u for 16\n", (unsigned) TokenMatcher<Tokens2>::flash_size(),
+			(unsigned) TokenMatcher<Tokens16>::flash_size());
+}
@@ -0,0 +1,10 @@
+#include <gtest/gtest.h>
+
+#include "bench.h"
+
+volatile unsigned long bench_sink;
+
+int main(int argc, char* argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,33 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include <chrono>
+#include <stdio.h>
+
+/*
+ * Minimal helpers for the micro-benchmarks. Each benchmark is a GTest case so that
+ * they can be listed and filtered the usual way: ./benchmarks --gtest_filter=RingBuffer*
+ */
+
+/* written by the benchmarks so that the compiler can't drop the measured loop */
+extern volatile unsigned long bench_sink;
+
+/* forces the compiler to assume memory changed, so a pure call is not hoisted out of a loop */
+#define BENCH_CLOBBER() asm volatile("" : : : "memory")
+
+/* run fct once and return the average time in ns of one of its ops operations */
+template<typename F>
+double bench_ns_per_op(unsigned long ops, F fct) {
+	auto start = std::chrono::steady_clock::now();
+	fct();
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	return std::chrono::duration<double, std::nano>(elapsed).count() / ops;
+}
+
+#define BENCH_REPORT(name, ns_per_op) \
+	printf("[   BENCH  ] %-40s %10.2f ns/op\n", name, ns_per_op)
+
+#define BENCH_REPORT_THROUGHPUT(name, bytes_per_s) \
+	printf("[   BENCH  ] %-40s %10.2f MB/s\n", name, (bytes_per_s) / 1e6)
+
+#endif
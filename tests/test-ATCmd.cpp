@@ -7,7 +7,9 @@
 
 #include <string.h>
 
-#define PRINT_BUFFER(b) fwrite(b.buffer(), 1, b.length(), stdout);
+#define PRINT_BUFFER(b) { auto segs = b.segments(); \
+	fwrite(segs.first.data, 1, segs.first.length, stdout); \
+	fwrite(segs.second.data, 1, segs.second.length, stdout); }
 
 #include <RingBuffer.h>
 #include <AT_CFUN.h>
@@ -110,20 +112,52 @@ private:
 	}
 };
 
+/* formats a command into the buffer of the fixture, for exec(buffer, length) */
+class BufferSink {
+public:
+	BufferSink(char* data, size_t size) :
+			_data(data), _size(size), _length(0) {
+	}
+	size_t write(const char* data, size_t len) {
+		if (len > _size - _length)
+			len = _size - _length;
+		memcpy(_data + _length, data, len);
+		_length += len;
+		return len;
+	}
+	BufferSink& clear() {
+		_length = 0;
+		return *this;
+	}
+private:
+	char* _data;
+	size_t _size;
+	size_t _length;
+};
+
 class ATCmdClient: public testing::Test {
 
 public:
+	ATCmdClient() :
+			tx(buffer, buff_len) {
+	}
+
+	/* the sink of the next command, from the start of buffer */
+	BufferSink& cmd() {
+		return tx.clear();
+	}
 
 	ATMockSerial serial;
 	static const size_t buff_len = 255;
 	char buffer[buff_len];
+	BufferSink tx;
 };
 
 TEST_F(ATCmdClient, at_timeout) {
 	ATCmd<ATMockSerial, 256> atcmd(serial);
 
 	EXPECT_CALL(serial, write(_ , _));
-	ASSERT_EQ(EXEC_PENDING, atcmd.exec(buffer, AT_OK::test(buffer, buff_len)));
+	ASSERT_EQ(EXEC_PENDING, atcmd.exec(buffer, AT_OK::test(cmd())));
 	ASSERT_EQ(ERROR_EXEC_TIMEOUT, atcmd.check_status(0));
 }
 
@@ -147,7 +181,7 @@ TEST_F(ATCmdClient, at_ok) {
 
 	serial.add_provision("\r\nOK\r\n");
 	EXPECT_CALL(serial, write(_ , _));
-	ASSERT_EQ(EXEC_PENDING, atcmd.exec(buffer, AT_OK::test(buffer, buff_len)));
+	ASSERT_EQ(EXEC_PENDING, atcmd.exec(buffer, AT_OK::test(cmd())));
 	ASSERT_EQ(EXEC_OK, atcmd.check_status());
 	EXPECT_CALL(serial, write(_ , _));
 	ASSERT_EQ(EXEC_PENDING, atcmd.exec(" ", 1));
@@ -159,7 +193,7 @@ TEST_F(ATCmdClient, at_error) {
 
 	serial.add_provision("\r\nERROR\r\n");
 	EXPECT_CALL(serial, write(_ , _));
-	ASSERT_EQ(EXEC_PENDING, atcmd.exec(buffer, AT_OK::test(buffer, buff_len)));
+	ASSERT_EQ(EXEC_PENDING, atcmd.exec(buffer, AT_OK::test(cmd())));
 	ASSERT_EQ(EXEC_ERROR, atcmd.check_status());
 	EXPECT_CALL(serial, write(_ , _));
 	ASSERT_EQ(EXEC_PENDING, atcmd.exec(" ", 1));
@@ -171,7 +205,7 @@ TEST_F(ATCmdClient, at_echo) {
 
 	serial.add_provision("\r\nOK\r\n");
 	EXPECT_CALL(serial, write(_ , _));
-	ASSERT_EQ(EXEC_PENDING, atcmd.exec(buffer, AT_ECHO::write(buffer, buff_len, AT_ECHO::OFF)));
+	ASSERT_EQ(EXEC_PENDING, atcmd.exec(buffer, AT_ECHO::write(cmd(), AT_ECHO::OFF)));
 	ASSERT_EQ(EXEC_OK, atcmd.check_status());
 }
 
@@ -180,21 +214,21 @@ TEST_F(ATCmdClient, at_cfun) {
 
 	serial.add_provision("OK\r\n");
 	EXPECT_CALL(serial, write(_ , _));
-	ASSERT_EQ(EXEC_PENDING, atcmd.exec(buffer, AT_CFUN::test(buffer, buff_len)));
+	ASSERT_EQ(EXEC_PENDING, atcmd.exec(buffer, AT_CFUN::test(cmd())));
 	ASSERT_EQ(EXEC_OK, atcmd.check_status());
 
 	serial.add_provision("\r\nOK\r\n");
 	EXPECT_CALL(serial, write(_ , _));
-	ASSERT_EQ(EXEC_PENDING, atcmd.exec(buffer, AT_CFUN::write(buffer, buff_len, AT_CFUN::FULL)));
+	ASSERT_EQ(EXEC_PENDING, atcmd.exec(buffer, AT_CFUN::write(cmd(), AT_CFUN::FULL)));
 	ASSERT_EQ(EXEC_OK, atcmd.check_status());
 
 	enum AT_CFUN::fun fun = AT_CFUN::MINIMAL;
 
 	serial.add_provision("\r\n+CFUN: 1\r\n\r\nOK\r\n");
 	EXPECT_CALL(serial, write(_, _));
-	ASSERT_EQ(EXEC_PENDING, atcmd.exec(buffer, AT_CFUN::read(buffer, buff_len)));
+	ASSERT_EQ(EXEC_PENDING, atcmd.exec(buffer, AT_CFUN::read(cmd())));
 	ASSERT_EQ(EVT_CFUN, atcmd.check_status());
-	ASSERT_EQ(1, AT_CFUN::parse<256>(atcmd.buffer, &fun));
+	ASSERT_EQ(1, AT_CFUN::parse(atcmd.buffer, &fun));
 	ASSERT_EQ(AT_CFUN::FULL, fun);
 	ASSERT_EQ(EXEC_OK, atcmd.check_status());
 }
@@ -203,7 +237,7 @@ TEST_F(ATCmdClient, at_cpin) {
 	ATCmd<ATMockSerial, 256> atcmd(serial);
 
 	EXPECT_CALL(serial, write(_ , _));
-	ASSERT_EQ(EXEC_PENDING, atcmd.exec(buffer, AT_CPIN::test(buffer, buff_len)));
+	ASSERT_EQ(EXEC_PENDING, atcmd.exec(buffer, AT_CPIN::test(cmd())));
 	ASSERT_EQ(EXEC_PENDING, atcmd.check_status());
 	serial.add_provision("OK\r\n");
 	ASSERT_EQ(EXEC_OK, atcmd.check_status());
@@ -212,30 +246,30 @@ TEST_F(ATCmdClient, at_cpin) {
 
 	serial.add_provision("\r\n+CPIN: SIM PUK\r\n\r\nOK\r\n");
 	EXPECT_CALL(serial, write(_ , _));
-	ASSERT_EQ(EXEC_PENDING, atcmd.exec(buffer, AT_CPIN::read(buffer, buff_len)));
+	ASSERT_EQ(EXEC_PENDING, atcmd.exec(buffer, AT_CPIN::read(cmd())));
 	ASSERT_EQ(EVT_CPIN, atcmd.check_status());
-	ASSERT_EQ(1, AT_CPIN::parse<256>(atcmd.buffer, &status));
+	ASSERT_EQ(1, AT_CPIN::parse(atcmd.buffer, &status));
 	ASSERT_EQ(AT_CPIN::SIM_PUK, status);
 	ASSERT_EQ(EXEC_OK, atcmd.check_status());
 
 	serial.add_provision("\r\n+CPIN: SIM PIN\r\n\r\nOK\r\n");
 	EXPECT_CALL(serial, write(_ , _));
-	ASSERT_EQ(EXEC_PENDING, atcmd.exec(buffer, AT_CPIN::read(buffer, buff_len)));
+	ASSERT_EQ(EXEC_PENDING, atcmd.exec(buffer, AT_CPIN::read(cmd())));
 	ASSERT_EQ(EVT_CPIN, atcmd.check_status());
-	ASSERT_EQ(1, AT_CPIN::parse<256>(atcmd.buffer, &status));
+	ASSERT_EQ(1, AT_CPIN::parse(atcmd.buffer, &status));
 	ASSERT_EQ(AT_CPIN::SIM_PIN, status);
 	ASSERT_EQ(EXEC_OK, atcmd.check_status());
 
 	serial.add_provision("\r\nOK\r\n");
 	EXPECT_CALL(serial, write(_ , _));
-	ASSERT_EQ(EXEC_PENDING, atcmd.exec(buffer, AT_CPIN::write(buffer, buff_len, "1234")));
+	ASSERT_EQ(EXEC_PENDING, atcmd.exec(buffer, AT_CPIN::write(cmd(), "1234")));
 	ASSERT_EQ(EXEC_OK, atcmd.check_status());
 
 	serial.add_provision("\r\n+CPIN: READY\r\n\r\nOK\r\n");
 	EXPECT_CALL(serial, write(_ , _));
-	ASSERT_EQ(EXEC_PENDING, atcmd.exec(buffer, AT_CPIN::read(buffer, buff_len)));
+	ASSERT_EQ(EXEC_PENDING, atcmd.exec(buffer, AT_CPIN::read(cmd())));
 	ASSERT_EQ(EVT_CPIN, atcmd.check_status());
-	ASSERT_EQ(1, AT_CPIN::parse<256>(atcmd.buffer, &status));
+	ASSERT_EQ(1, AT_CPIN::parse(atcmd.buffer, &status));
 	ASSERT_EQ(AT_CPIN::READY, status);
 	ASSERT_EQ(EXEC_OK, atcmd.check_status());
 }
@@ -245,7 +279,7 @@ TEST_F(ATCmdClient, at_dtmf) {
 
 	serial.add_provision("\r\nOK\r\n");
 	EXPECT_CALL(serial, write(_ , _));
-	ASSERT_EQ(EXEC_PENDING, atcmd.exec(buffer, AT_DTMF::write(buffer, buff_len, AT_DTMF::ENABLE)));
+	ASSERT_EQ(EXEC_PENDING, atcmd.exec(buffer, AT_DTMF::write(cmd(), AT_DTMF::ENABLE)));
 	ASSERT_EQ(EXEC_OK, atcmd.check_status());
 
 	std::string tones[] = {"1", "9", "*", "#"};
@@ -257,7 +291,7 @@ TEST_F(ATCmdClient, at_dtmf) {
 	for (auto t: tones) {
 		char tone;
 		ASSERT_EQ(EVT_DTMF, atcmd.check_status());
-		ASSERT_EQ(1, AT_DTMF::parse<256>(atcmd.buffer, &tone));
+		ASSERT_EQ(1, AT_DTMF::parse(atcmd.buffer, &tone));
 		ASSERT_EQ(t[0], tone);
 	}
 }
@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+#include <string.h>
+#include <string>
+
+#include <Arduino.h>
+#include <RingBuffer.h>
+#include <AtFormat.h>
+#include <AT_CFUN.h>
+#include <AT_DDET.h>
+#include <AT_CSQ.h>
+
+/* sink recording every write, as a serial port would receive them */
+class StringSink {
+public:
+	StringSink(size_t limit = -1) :
+			writes(0), _limit(limit) {
+	}
+	size_t write(const char* data, size_t len) {
+		++writes;
+		if (len > _limit - out.size())
+			len = _limit - out.size();
+		out.append(data, len);
+		return len;
+	}
+	std::string out;
+	int writes;
+private:
+	size_t _limit;
+};
+
+TEST(AtFormat, directives) {
+	StringSink sink;
+	ASSERT_EQ(at_format(sink, "AT+X=%d,%u,%i,%s,%c%%\r\n", -12, 4000000000UL, 0, "abc", 'z'), 30);
+	ASSERT_EQ(sink.out, "AT+X=-12,4000000000,0,abc,z%\r\n");
+	sink.out.clear();
+	ASSERT_EQ(at_format(sink, "%d|%d|%c", (int32_t) -2147483647 - 1, (uint8_t) 255, 65), 17);
+	ASSERT_EQ(sink.out, "-2147483648|255|A");
+	sink.out.clear();
+	// a char goes as a number unless %c
+	ASSERT_EQ(at_format(sink, "%d", '0'), 2);
+	ASSERT_EQ(sink.out, "48");
+}
+
+TEST(AtFormat, arguments_mismatch) {
+	StringSink sink;
+	// missing argument: the directive is dropped
+	ASSERT_EQ(at_format(sink, "A%dB%%C"), 4);
+	ASSERT_EQ(sink.out, "AB%C");
+	sink.out.clear();
+	// extra argument: ignored
+	ASSERT_EQ(at_format(sink, "AT\r\n", 1, "x"), 4);
+	ASSERT_EQ(sink.out, "AT\r\n");
+	sink.out.clear();
+	ASSERT_EQ(at_format(sink, "100%"), 3);
+	ASSERT_EQ(sink.out, "100");
+	ASSERT_EQ(at_format(sink, ""), 0);
+}
+
+TEST(AtFormat, streaming) {
+	StringSink sink;
+	at_format(sink, "AT+CPIN=%s\r\n", "1234");
+	// literal, argument, literal: no intermediate buffer
+	ASSERT_EQ(sink.writes, 3);
+	// the sink is short, the bytes it accepted are reported
+	StringSink short_sink(6);
+	ASSERT_EQ(at_format(short_sink, "AT+CPIN=%s\r\n", "1234"), 6);
+	ASSERT_EQ(short_sink.out, "AT+CPI");
+	ASSERT_EQ(at_length("AT+CPIN=%s\r\n", "1234"), 14);
+}
+
+TEST(AtFormat, queue) {
+	StringBuffer<16> tx;
+	tx.append("----------");
+	tx.pop_firsts(8);
+	// straddles the end of the ring
+	ASSERT_EQ(at_queue(tx, "AT+DDET=%d\r\n", 1), 11);
+	ASSERT_EQ(tx.length(), 13);
+	tx.pop_firsts(2);
+	ASSERT_EQ(tx.index_of("AT+DDET=1\r\n"), 0);
+	// whole command or nothing
+	ASSERT_EQ(at_queue(tx, "AT+CSQ\r\n"), 0);
+	ASSERT_EQ(tx.length(), 11);
+	RingBuffer<16, char> raw;
+	ASSERT_EQ(at_queue(raw, "AT+CFUN=%d\r\n", 4), 11);
+}
+
+TEST(AtFormat, commands) {
+	StringSink sink;
+	AT_CFUN::write(sink, AT_CFUN::DISABLE, AT_CFUN::RESET);
+	AT_CFUN::read(sink);
+	AT_CFUN::test(sink);
+	AT_DTMF::write(sink, AT_DTMF::ENABLE);
+	AT_CSQ::exec(sink);
+	ASSERT_EQ(sink.out, "AT+CFUN=4,1\r\nAT+CFUN?\r\nAT+CFUN=?\r\n"
+			"AT+DDET=1\r\nAT+CSQ\r\n");
+	StringBuffer<32> tx;
+	AtRingSink<StringBuffer<32> > ring(tx);
+	ASSERT_EQ(AT_CFUN::write(ring, AT_CFUN::FULL), 13);
+	ASSERT_EQ(tx.index_of("AT+CFUN=1,0\r\n"), 0);
+}
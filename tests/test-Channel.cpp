@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <Arduino.h>
+#include <Channel.h>
+
+/////////////////////////////////////////////////////////////////////
+
+TEST(Channel, send_recv) {
+	Channel<int, 3> ch;
+	int value = -1;
+	ASSERT_TRUE(ch.empty());
+	ASSERT_FALSE(ch.recv(&value));
+	ASSERT_EQ(-1, value);
+	// signaled on the transitions only: from empty, from full
+	uint16_t readable = ch.readable().count();
+	for (int i = 0; i < 3; ++i)
+		ASSERT_TRUE(ch.send(i));
+	ASSERT_TRUE(ch.full());
+	ASSERT_FALSE(ch.send(3));
+	ASSERT_EQ(3, ch.length());
+	ASSERT_EQ((uint16_t) (readable + 1), ch.readable().count());
+
+	uint16_t writable = ch.writable().count();
+	ASSERT_TRUE(ch.recv(&value));
+	ASSERT_EQ(0, value);
+	ASSERT_EQ((uint16_t) (writable + 1), ch.writable().count());
+	ASSERT_TRUE(ch.send(3));
+	ASSERT_EQ((uint16_t) (readable + 1), ch.readable().count());
+	for (int i = 1; i < 4; ++i) {
+		ASSERT_TRUE(ch.recv(&value));
+		ASSERT_EQ(i, value);
+	}
+	ASSERT_TRUE(ch.empty());
+}
+
+/////////////////////////////////////////////////////////////////////
+
+Channel<int, 4> g_chan;
+
+COROUTINE(int, ChanProducer,
+	CORO_ARG(ChanProducer, int, count)
+	CORO_ARG(ChanProducer, unsigned long, pause)
+	CORO_VAR(int, i)
+)
+CORO_START(ChanProducer);
+{
+	for (i = 1; i <= count; ++i) {
+		SEND(g_chan, i);
+		if (pause != 0)
+			SLEEP(pause);
+	}
+}
+CORO_RETURN(i - 1);
+CORO_END();
+
+COROUTINE(int, ChanConsumer,
+	CORO_ARG(ChanConsumer, int, count)
+	CORO_VAR(int, i)
+	CORO_VAR(int, value)
+	CORO_VAR(int, sum)
+)
+CORO_START(ChanConsumer);
+{
+	sum = 0;
+	for (i = 0; i < count; ++i) {
+		RECV(g_chan, value);
+		EXPECT_EQ(i + 1, value);
+		sum += value;
+	}
+}
+CORO_RETURN(sum);
+CORO_END();
+
+static void chan_ignore(uint8_t, const ICoroutine*) {
+}
+
+TEST(Channel, parked) {
+	ICoroutine* consumer = (new ChanConsumer())->set_count(1);
+	ICoroutine* coroutines[] = {consumer};
+	unsigned long next_wake;
+	// empty: parked, not due until a send
+	ASSERT_EQ(1, schedule_coro_once(coroutines, 1, chan_ignore, &next_wake));
+	ASSERT_FALSE(consumer->due(millis()));
+	g_chan.send(1);
+	ASSERT_TRUE(consumer->due(millis()));
+	ASSERT_EQ(0, schedule_coro_once(coroutines, 1, chan_ignore, &next_wake));
+
+	// full: the producer is parked until a recv
+	ICoroutine* producer = (new ChanProducer())->set_count(5)->set_pause(0);
+	coroutines[0] = producer;
+	ASSERT_EQ(1, schedule_coro_once(coroutines, 1, chan_ignore, &next_wake));
+	ASSERT_TRUE(g_chan.full());
+	ASSERT_FALSE(producer->due(millis()));
+	int value;
+	ASSERT_TRUE(g_chan.recv(&value));
+	ASSERT_EQ(1, value);
+	ASSERT_TRUE(producer->due(millis()));
+	ASSERT_EQ(0, schedule_coro_once(coroutines, 1, chan_ignore, &next_wake));
+	for (int i = 2; i <= 5; ++i) {
+		ASSERT_TRUE(g_chan.recv(&value));
+		ASSERT_EQ(i, value);
+	}
+}
+
+TEST(Channel, pipeline) {
+	// more items than room: the producer waits for the consumer, in order
+	ICoroutine* coroutines[] = {(new ChanConsumer())->set_count(20),
+			(new ChanProducer())->set_count(20)->set_pause(0)};
+	static int results[2];
+	schedule_coro(coroutines, 2, [](uint8_t idx, const ICoroutine* coro) {
+		ASSERT_FALSE(((ICoroutine*) coro)->has_timeout());
+		results[idx] = idx == 0 ? ((ChanConsumer*) coro)->result() : ((ChanProducer*) coro)->result();
+	});
+	ASSERT_EQ(210, results[0]);
+	ASSERT_EQ(20, results[1]);
+	ASSERT_TRUE(g_chan.empty());
+}
+
+TEST(Channel, pipeline_sleeps) {
+	// a slow producer: the consumer is not polled in between, the waiting is spent asleep
+	ICoroutine* coroutines[] = {(new ChanConsumer())->set_count(5),
+			(new ChanProducer())->set_count(5)->set_pause(30)};
+	clock_t cpu = clock();
+	unsigned long start = millis();
+	schedule_coro(coroutines, 2, chan_ignore);
+	ASSERT_GE(millis() - start, 120u);
+	ASSERT_LT((clock() - cpu) * 1000 / CLOCKS_PER_SEC, 50);
+	ASSERT_TRUE(g_chan.empty());
+}
@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <vector>
+
+#include <Arduino.h>
+#include <CoroAsync.h>
+
+/////////////////////////////////////////////////////////////////////
+
+CoroAsync<int> async_count(int limit) {
+	int count = 0;
+	while (count < limit) {
+		++count;
+		co_await coro_yield();
+	}
+	co_return count;
+}
+
+/* ends without suspending once its sub coroutine is done */
+CoroAsync<int> async_sum(int first, int second) {
+	CoroAsync<int> sub = async_count(first);
+	int sum = co_await sub;
+	sum += co_await async_count(second);
+	co_return sum;
+}
+
+CoroAsync<int> async_forever() {
+	while (true)
+		co_await coro_yield();
+	co_return 0;
+}
+
+/* -1 if the sub coroutine timed out, the contract of HAS_TIMEOUT() */
+CoroAsync<int> async_guarded(unsigned long timeout_ms) {
+	CoroAsync<int> sub = async_forever().timeout(timeout_ms);
+	int value = co_await sub;
+	co_return sub.has_timeout() ? -1 : value;
+}
+
+/* number of runs until the end */
+template<typename T>
+int run_to_end(CoroAsync<T>& coro) {
+	int runs = 0;
+	while (coro.live()) {
+		coro.run();
+		++runs;
+	}
+	return runs;
+}
+
+TEST(CoroAsync, count) {
+	{
+		CoroAsync<int> coro = async_count(10);
+		ASSERT_TRUE(coro.live());
+		ASSERT_EQ(11, run_to_end(coro));
+		ASSERT_FALSE(coro.has_timeout());
+		ASSERT_EQ(10, coro.result());
+		coro.run(); // harmless once done
+		ASSERT_EQ(10, coro.result());
+		ASSERT_EQ(1, CoroArena::in_use()); // the frame holds the result up to the destruction
+	}
+	ASSERT_EQ(0, CoroArena::in_use());
+}
+
+TEST(CoroAsync, nested_await) {
+	CoroArena::reset_stats();
+	CoroAsync<int> coro = async_sum(3, 4);
+	// 3 + 4 yields, then one run to end: a sub ending resumes its awaiting coroutine in the same run
+	ASSERT_EQ(3 + 4 + 1, run_to_end(coro));
+	ASSERT_FALSE(coro.has_timeout());
+	ASSERT_EQ(7, coro.result());
+	ASSERT_EQ(3, CoroArena::allocations());
+	ASSERT_EQ(3, CoroArena::peak()); // sub is a local, still there during the second await
+}
+
+TEST(CoroAsync, timeout) {
+	CoroAsync<int> coro = async_forever().timeout(20);
+	unsigned long start = millis();
+	while (coro.live())
+		coro.run();
+	ASSERT_TRUE(coro.has_timeout());
+	ASSERT_GE(millis() - start, 20);
+	ASSERT_EQ(0, coro.result());
+}
+
+TEST(CoroAsync, nested_timeout) {
+	CoroAsync<int> coro = async_guarded(20);
+	while (coro.live())
+		coro.run();
+	ASSERT_FALSE(coro.has_timeout());
+	ASSERT_EQ(-1, coro.result());
+}
+
+TEST(CoroAsync, schedule_coro) {
+	static std::vector<int> ended;
+	ended.clear();
+	ICoroutine* coroutines[] = {new CoroAsync<int>(async_count(10)), new CoroAsync<int>(async_sum(1, 2))};
+	schedule_coro(coroutines, 2, [](uint8_t idx, const ICoroutine* coro) {
+		ended.push_back(idx);
+		ended.push_back(((CoroAsync<int>*) coro)->result());
+	});
+	ASSERT_EQ(std::vector<int>({1, 3, 0, 10}), ended);
+	ASSERT_EQ(0, CoroArena::in_use());
+}
+
+TEST(CoroAsync, arena_exhausted) {
+	CoroArena::reset_stats();
+	std::vector<CoroAsync<int>> coros;
+	coros.reserve(CoroArena::capacity() + 1);
+	for (int i = 0; i <= CoroArena::capacity(); ++i)
+		coros.push_back(async_count(1));
+	ASSERT_EQ(CoroArena::capacity(), CoroArena::in_use());
+	ASSERT_EQ(1, CoroArena::exhausted());
+
+	// the last one has no frame: born timed out
+	ASSERT_FALSE(coros.back().live());
+	ASSERT_TRUE(coros.back().has_timeout());
+	ASSERT_EQ(0, coros.back().result());
+	ASSERT_EQ(2, run_to_end(coros.front()));
+	ASSERT_EQ(1, coros.front().result());
+
+	coros.clear();
+	ASSERT_EQ(0, CoroArena::in_use());
+	ASSERT_LE(CoroArena::largest(), CORO_ARENA_BLOCK_SIZE);
+}
@@ -0,0 +1,142 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+#include <unistd.h>
+
+#include <Arduino.h>
+#include <CoroCtxScheduler.h>
+
+/////////////////////////////////////////////////////////////////////
+CORO_CTX(int, Spin,
+	int limit;
+	int count;
+	const size_t* owner;
+	std::atomic<int>* moved;
+)
+
+static size_t thread_hash() {
+	return std::hash<std::thread::id>()(std::this_thread::get_id());
+}
+
+CORO_BEGIN_CTX(Spin)
+{
+	for (ctx.count = 0; ctx.count < ctx.limit; ++ctx.count) {
+		if (ctx.owner != nullptr && *ctx.owner != thread_hash())
+			++*ctx.moved;
+		YIELD_CTX();
+	}
+}
+CORO_RETURN_CTX(ctx.count);
+CORO_END_CTX()
+
+CORO_CTX(int, SpinParent,
+	int limit;
+	int count;
+	size_t owner;
+	std::atomic<int>* moved;
+	SpinCtx child;
+)
+CORO_BEGIN_CTX(SpinParent)
+{
+	// free to move
+	for (ctx.count = 0; ctx.count < ctx.limit; ++ctx.count)
+		YIELD_CTX();
+	// pinned
+	CORO_INIT(ctx.child, TIMEOUT_MS * 100);
+	ctx.child.limit = ctx.limit;
+	ctx.child.owner = &ctx.owner;
+	ctx.child.moved = ctx.moved;
+	ctx.owner = thread_hash();
+	AWAIT_CTX(Spin, ctx.child);
+	YIELD_CTX();
+}
+CORO_RETURN_CTX(CORO_RESULT(ctx.child));
+CORO_END_CTX()
+
+TEST(CoroCtxScheduler, run) {
+	const int count = 1000;
+	static SpinCtx ctx[count];
+	CoroCtxScheduler scheduler(4);
+	ASSERT_EQ(scheduler.workers(), 4);
+	for (int i = 0; i < count; ++i) {
+		CORO_INIT(ctx[i], TIMEOUT_MS * 100);
+		ctx[i].limit = i % 50;
+		CORO_SPAWN(scheduler, Spin, ctx[i]);
+	}
+	scheduler.run();
+	uint64_t runs = 0;
+	for (int i = 0; i < count; ++i) {
+		ASSERT_FALSE(CORO_ALIVE(ctx[i]));
+		ASSERT_FALSE(CORO_HAS_TIMEOUT(ctx[i]));
+		ASSERT_EQ(CORO_RESULT(ctx[i]), i % 50);
+		runs += i % 50 + 1;
+	}
+	ASSERT_EQ(scheduler.runs(), runs);
+}
+
+TEST(CoroCtxScheduler, steal_but_pinned_in_await) {
+	const int count = 2000;
+	static SpinParentCtx ctx[count];
+	std::atomic<int> moved(0);
+	CoroCtxScheduler scheduler(4);
+	// all on the first worker, the others have to steal
+	for (int i = 0; i < count; ++i) {
+		CORO_INIT(ctx[i], TIMEOUT_MS * 100);
+		ctx[i].limit = 200;
+		ctx[i].moved = &moved;
+		scheduler.spawn(&ctx[i], &coro_task_run<SpinParentCtx, SpinParent>, 0);
+	}
+	scheduler.run();
+	for (int i = 0; i < count; ++i)
+		ASSERT_EQ(CORO_RESULT(ctx[i]), 200);
+	ASSERT_GT(scheduler.steals(), 0);
+	ASSERT_EQ(moved, 0);
+}
+
+CORO_CTX(int, Hog,
+	int runs;
+)
+CORO_BEGIN_CTX(Hog)
+{
+	for (ctx.runs = 0; ctx.runs < 40; ++ctx.runs) {
+		usleep(5 * 1000);
+		YIELD_CTX();
+	}
+}
+CORO_RETURN_CTX(ctx.runs);
+CORO_END_CTX()
+
+CORO_CTX(int, Spawner,
+	CoroCtxScheduler* scheduler;
+	SpinCtx child;
+)
+CORO_BEGIN_CTX(Spawner)
+{
+	usleep(20 * 1000); // worker 1 has read the clock, and runs the hog without reading it again
+	YIELD_CTX();
+	CoroPass::refresh();
+	CORO_INIT(ctx.child, 1000);
+	ctx.child.limit = 1;
+	ctx.scheduler->spawn(&ctx.child, &coro_task_run<SpinCtx, Spin>, 1);
+	// busy meanwhile: worker 0 does not steal the child
+	while (CORO_ALIVE(ctx.child))
+		YIELD_CTX();
+}
+CORO_RETURN_CTX(0);
+CORO_END_CTX()
+
+TEST(CoroCtxScheduler, spawn_on_older_tick) {
+	// the child starts on worker 0 and first runs on worker 1, whose tick is older than its start
+	static HogCtx hog;
+	static SpawnerCtx spawner;
+	CoroCtxScheduler scheduler(2);
+	CORO_INIT(hog, TIMEOUT_MS * 100);
+	scheduler.spawn(&hog, &coro_task_run<HogCtx, Hog>, 1);
+	CORO_INIT(spawner, TIMEOUT_MS * 100);
+	spawner.scheduler = &scheduler;
+	scheduler.spawn(&spawner, &coro_task_run<SpawnerCtx, Spawner>, 0);
+	scheduler.run();
+	ASSERT_EQ(CORO_RESULT(hog), 40);
+	ASSERT_FALSE(CORO_HAS_TIMEOUT(spawner.child));
+	ASSERT_EQ(CORO_RESULT(spawner.child), 1);
+}
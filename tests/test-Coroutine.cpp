@@ -1,9 +1,17 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 #include <memory>
+#include <vector>
+#include <time.h>
+
+#include <thread>
+#include <unistd.h>
 
 #include <Arduino.h>
 #include <Coroutine.h>
+#include <RingBuffer.h>
+#include <SpscRingBuffer.h>
+#include <SearchCursor.h>
 
 using ::testing::_;
 using ::testing::Field;
@@ -111,3 +119,445 @@ TEST(Coroutine, two_countchar) {
 	schedule_coro(coroutines, sizeof (coroutines) / sizeof(coroutines[0]), clk_forward);
 	delete g_sched;
 }
+
+/////////////////////////////////////////////////////////////////////
+
+TEST(Coroutine, pool) {
+	uint16_t in_use = CoroPool::in_use();
+	CoroPool::reset_stats();
+	ICoroutine* coroutines[] = {
+			CORO_NEW(CountChar, set_from('A')->set_to('C')),
+			CORO_NEW(CountChar, set_from('B')->set_to('D'))};
+	ASSERT_EQ(CoroPool::in_use(), in_use + 2);
+	ASSERT_NE(nullptr, coroutines[0]);
+
+	g_sched = new SchedulerClkMock();
+	EXPECT_CALL(*g_sched, callback(_, _)).Times(2);
+	schedule_coro(coroutines, sizeof (coroutines) / sizeof(coroutines[0]), clk_forward);
+	delete g_sched;
+	// 2 coroutines, each awaiting Delay, CountNumber and Delay
+	ASSERT_EQ(CoroPool::allocations(), 8);
+	ASSERT_EQ(CoroPool::peak(), in_use + 4);
+	ASSERT_EQ(CoroPool::in_use(), in_use);
+	ASSERT_EQ(CoroPool::exhausted(), 0);
+}
+
+COROUTINE(int, AwaitExhausted,
+	CORO_VAR(bool, timeout)
+)
+CORO_START(AwaitExhausted);
+{
+	AWAIT(CORO_NEW(CountNumber, set_limit(1000)));
+	timeout = HAS_TIMEOUT();
+}
+CORO_RETURN(timeout);
+CORO_END();
+
+TEST(Coroutine, pool_exhausted) {
+	CoroPool::reset_stats();
+	ICoroutine* awaiter = new AwaitExhausted();
+	std::vector<ICoroutine*> filler;
+	while (CoroPool::in_use() < CoroPool::capacity())
+		filler.push_back(new Delay(1000));
+	ASSERT_EQ(CoroPool::exhausted(), 0);
+
+	// no block left: nullptr, neither the constructor nor the setters are run
+	ICoroutine* coro = new Delay(1000);
+	ASSERT_EQ(nullptr, coro);
+	ASSERT_EQ(nullptr, CORO_NEW(CountNumber, set_limit(3)));
+	delete coro;
+	ASSERT_EQ(CoroPool::exhausted(), 2);
+
+	// AWAIT returns at once
+	awaiter->run();
+	ASSERT_FALSE(awaiter->live());
+	ASSERT_FALSE(awaiter->has_timeout());
+	ASSERT_EQ(((AwaitExhausted*) awaiter)->result(), 1);
+	ASSERT_EQ(CoroPool::exhausted(), 3);
+	delete awaiter;
+
+	for (size_t i = 0; i < filler.size(); ++i)
+		delete filler[i];
+	coro = new Delay(1000);
+	ASSERT_NE(nullptr, coro);
+	delete coro;
+}
+
+COROUTINE(int, AwaitLost,
+	CORO_ARG(AwaitLost, int, limit)
+	CORO_VAR(bool, timeout)
+)
+CORO_START(AwaitLost);
+{
+	AWAIT(CORO_NEW(CountNumber, set_limit(limit)));
+	timeout = HAS_TIMEOUT();
+}
+CORO_RETURN(timeout ? 100 + RESULT(CountNumber) : RESULT(CountNumber));
+CORO_END();
+
+TEST(Coroutine, pool_exhausted_holders) {
+	// two coroutines awaiting on the full pool at once: nothing shared between them
+	ICoroutine* coroutines[] = {CORO_NEW(AwaitLost, set_limit(3)), CORO_NEW(AwaitLost, set_limit(4)), nullptr};
+	std::vector<ICoroutine*> filler;
+	while (CoroPool::in_use() < CoroPool::capacity())
+		filler.push_back(new Delay(10000));
+	CoroPool::reset_stats();
+	coroutines[2] = CORO_NEW(AwaitLost, set_limit(5));
+	ASSERT_EQ(nullptr, coroutines[2]);
+	// two holders of an exhausted allocation, both deleted
+	ICoroutine* a = new Delay(1000);
+	ICoroutine* b = new Delay(1000);
+	ASSERT_EQ(nullptr, a);
+	ASSERT_EQ(nullptr, b);
+	delete a;
+	delete b;
+
+	static std::vector<int> ended;
+	ended.clear();
+	// the nullptr slot is not reported to the callback, only counted
+	ASSERT_EQ(1, schedule_coro(coroutines, 3, [](uint8_t idx, const ICoroutine* coro) {
+		ended.push_back(idx);
+		ended.push_back(((AwaitLost*) coro)->result());
+	}));
+	// timed out with the default result, until the first one deleted gives its block back
+	// to the second
+	ASSERT_EQ(std::vector<int>({0, 100, 1, 4}), ended);
+	ASSERT_EQ(4, CoroPool::exhausted());
+	ASSERT_EQ(CoroPool::capacity() - 2, CoroPool::in_use());
+	for (size_t i = 0; i < filler.size(); ++i)
+		delete filler[i];
+	ASSERT_EQ(0, CoroPool::in_use());
+}
+
+/////////////////////////////////////////////////////////////////////
+
+COROUTINE(int, Sleeper,
+	CORO_VAR(int, i)
+)
+CORO_START(Sleeper);
+{
+	for (i = 0; i < 3; ++i)
+		SLEEP(30);
+}
+CORO_RETURN(i);
+CORO_END();
+
+TEST(Coroutine, sleep) {
+	unsigned long start = millis();
+	Sleeper* sleeper = new Sleeper();
+	ICoroutine* coroutines[] = {sleeper, new Delay(1000)};
+	unsigned long next_wake;
+	ASSERT_EQ(schedule_coro_once(coroutines, 2, clk_forward, &next_wake), 2);
+	// the Sleeper is the earliest, the Delay is only due at its timeout
+	ASSERT_GE((long) (next_wake - start), 30);
+	ASSERT_LE((long) (next_wake - start), 31 + (long) (millis() - start));
+	ASSERT_LT((long) (next_wake - coroutines[1]->wake()), 0);
+	ASSERT_GE((long) (coroutines[1]->wake() - start), 1000);
+
+	// not due: not run
+	ASSERT_EQ(schedule_coro_once(coroutines, 2, clk_forward, &next_wake), 2);
+	ASSERT_TRUE(sleeper->live());
+	coro_sleep_until(next_wake);
+	ASSERT_GE((long) (millis() - next_wake), 0);
+	ASSERT_EQ(schedule_coro_once(coroutines, 2, clk_forward, &next_wake), 2);
+	ASSERT_GE((long) (next_wake - start), 60);
+	delete coroutines[0];
+	delete coroutines[1];
+}
+
+TEST(Coroutine, schedule_sleeps) {
+	g_sched = new SchedulerClkMock();
+	ICoroutine* coroutines[] = {new Delay(200), (new CountChar())->set_from('A')->set_to('C')};
+
+	EXPECT_CALL(*g_sched, callback(_, _)).Times(2);
+	clock_t cpu = clock();
+	unsigned long start = millis();
+	schedule_coro(coroutines, sizeof (coroutines) / sizeof(coroutines[0]), clk_forward);
+	ASSERT_GE(millis() - start, 200);
+	// the Delays are not polled, the waiting is spent asleep
+	ASSERT_LT((clock() - cpu) * 1000 / CLOCKS_PER_SEC, 50);
+	delete g_sched;
+}
+
+/////////////////////////////////////////////////////////////////////
+
+SpscRingBuffer<64, char> g_rx;
+CoroEvent g_rx_event;
+
+COROUTINE(int, WaitBytes,
+	CORO_ARG(WaitBytes, uint16_t, count)
+	CORO_VAR(int, checks)
+)
+CORO_START(WaitBytes);
+{
+	checks = 0;
+	WAIT_READY(g_rx_event, (++checks, g_rx.length() >= count));
+}
+CORO_RETURN(checks);
+CORO_END();
+
+TEST(Coroutine, wait_ready_thread) {
+	g_sched = new SchedulerClkMock();
+	ICoroutine* coroutines[] = {(new WaitBytes(2000))->set_count(5)};
+	int checks = 0;
+	EXPECT_CALL(*g_sched, callback(0, _)).WillOnce(Invoke(
+		[&checks](Unused, const ICoroutine* coro) {
+			ASSERT_FALSE(((WaitBytes*) coro)->has_timeout());
+			checks = ((WaitBytes*) coro)->result();
+		}
+	));
+	// the reader thread: one byte every 20 ms
+	std::thread reader([]() {
+		for (int i = 0; i < 5; ++i) {
+			usleep(20 * 1000);
+			g_rx.append('a' + i);
+			g_rx_event.signal();
+		}
+	});
+	unsigned long start = millis();
+	schedule_coro(coroutines, 1, clk_forward);
+	reader.join();
+	ASSERT_LT(millis() - start, 1000);
+	// checked once per byte, plus the first time
+	ASSERT_LE(checks, 6);
+	g_rx.discard(g_rx.length());
+	delete g_sched;
+}
+
+TEST(Coroutine, wait_ready_many_signals) {
+	// 256 signals between two checks: not taken for none
+	ICoroutine* coro = (new WaitBytes(2000))->set_count(1);
+	coro->run();
+	ASSERT_FALSE(coro->due(millis()));
+	for (int i = 0; i < 256; ++i)
+		g_rx_event.signal();
+	ASSERT_TRUE(coro->due(millis()));
+	g_rx.append('a');
+	coro->run();
+	ASSERT_FALSE(coro->live());
+	ASSERT_FALSE(coro->has_timeout());
+	delete coro;
+	g_rx.discard(g_rx.length());
+}
+
+StringBuffer<64> g_modem;
+CoroEvent g_modem_event;
+
+COROUTINE(int, Modem,
+	CORO_VAR(int, i)
+)
+CORO_START(Modem);
+{
+	for (i = 0; i < 8; ++i) {
+		SLEEP(5);
+		g_modem.append(i < 7 ? "+CPIN" : ": READY\r\n");
+		g_modem_event.signal();
+	}
+}
+CORO_RETURN(0);
+CORO_END();
+
+COROUTINE(int, WaitToken,
+	CORO_VAR(int, checks)
+	CORO_VAR(SearchCursor<StringBuffer<64> >*, cursor)
+)
+CORO_START(WaitToken);
+{
+	checks = 0;
+	cursor = new SearchCursor<StringBuffer<64> >(g_modem, "+CPIN:");
+	WAIT_READY(g_modem_event, (++checks, cursor->poll() != g_modem.END));
+	delete cursor;
+}
+CORO_RETURN(checks);
+CORO_END();
+
+COROUTINE(int, AwaitToken,
+	CORO_VAR(int, checks)
+)
+CORO_START(AwaitToken);
+{
+	AWAIT(new WaitToken());
+	checks = RESULT(WaitToken);
+}
+CORO_RETURN(checks);
+CORO_END();
+
+TEST(Coroutine, wait_ready_token) {
+	g_sched = new SchedulerClkMock();
+	ICoroutine* coroutines[] = {new AwaitToken(), new Modem()};
+	unsigned long next_wake;
+	ASSERT_EQ(schedule_coro_once(coroutines, 2, clk_forward, &next_wake), 2);
+	// parked: not due, even through AWAIT
+	ASSERT_FALSE(coroutines[0]->due(millis()));
+	ASSERT_GT((long) (coroutines[0]->wake() - millis()), 1000);
+
+	int checks = 0;
+	EXPECT_CALL(*g_sched, callback(0, _)).WillOnce(Invoke(
+		[&checks](Unused, const ICoroutine* coro) {
+			ASSERT_FALSE(((AwaitToken*) coro)->has_timeout());
+			checks = ((AwaitToken*) coro)->result();
+		}
+	));
+	EXPECT_CALL(*g_sched, callback(1, _));
+	schedule_coro(coroutines, 2, clk_forward);
+	// once at start then once per signal, not once per pass
+	ASSERT_EQ(checks, 9);
+	g_modem.clear();
+	delete g_sched;
+}
+
+/////////////////////////////////////////////////////////////////////
+
+TEST(Coroutine, clock_wrap) {
+	const unsigned long before_wrap = 0UL - 16;
+	ASSERT_TRUE(coro_before(before_wrap, 5));
+	ASSERT_FALSE(coro_before(5, before_wrap));
+	ASSERT_FALSE(coro_before(5, 5));
+	ASSERT_FALSE(coro_expired(before_wrap, 21, 5));
+	ASSERT_TRUE(coro_expired(before_wrap, 20, 5));
+	// a now slightly before start, on both sides of the wrap
+	ASSERT_FALSE(coro_expired(100, 1000, 99));
+	ASSERT_FALSE(coro_expired(5, 1000, before_wrap));
+}
+
+/* the ticks seen by the coroutines of a pass */
+static std::vector<unsigned long> g_ticks;
+
+COROUTINE(int, SlowTick,
+)
+CORO_START(SlowTick);
+{
+	g_ticks.push_back(coro_now());
+	usleep(20 * 1000);
+	g_ticks.push_back(coro_now());
+}
+CORO_RETURN(0);
+CORO_END();
+
+TEST(Coroutine, clock_pass) {
+	g_sched = new SchedulerClkMock();
+	g_ticks.clear();
+	ICoroutine* coroutines[] = {new SlowTick(), new SlowTick()};
+	unsigned long next_wake;
+	EXPECT_CALL(*g_sched, callback(_, _)).Times(2);
+	ASSERT_EQ(0, schedule_coro_once(coroutines, 2, clk_forward, &next_wake));
+	// one clock read for the whole pass
+	ASSERT_EQ(4u, g_ticks.size());
+	for (size_t i = 1; i < g_ticks.size(); ++i)
+		ASSERT_EQ(g_ticks[0], g_ticks[i]);
+	// out of a pass, the clock itself
+	unsigned long start = coro_now();
+	usleep(20 * 1000);
+	ASSERT_GE(coro_now() - start, 10u);
+	{
+		CoroPass pass;
+		CoroPass nested;
+		start = coro_now();
+		usleep(20 * 1000);
+		CoroPass::refresh();
+		ASSERT_GE(coro_now() - start, 10u);
+	}
+	delete g_sched;
+}
+
+/////////////////////////////////////////////////////////////////////
+
+COROUTINE(int, AllOf,
+)
+CORO_START(AllOf);
+{
+	AWAIT_ALL((new CountNumber())->set_limit(3), new Delay(40), (new CountNumber())->set_limit(5));
+	ASSERT_FALSE(HAS_TIMEOUT_OF(0));
+	ASSERT_TRUE(HAS_TIMEOUT_OF(1));
+	ASSERT_FALSE(HAS_TIMEOUT_OF(2));
+	ASSERT_EQ(4, CoroPool::in_use());
+}
+CORO_RETURN(RESULT_OF(0, CountNumber) * 10 + RESULT_OF(2, CountNumber));
+CORO_END();
+
+TEST(Coroutine, await_all) {
+	g_sched = new SchedulerClkMock();
+	ICoroutine* coroutines[] = {new AllOf()};
+	EXPECT_CALL(*g_sched, callback(0, _)).WillOnce(WithArg<1>(Invoke([](const ICoroutine* coro) {
+		ASSERT_FALSE(((AllOf*) coro)->has_timeout());
+		ASSERT_EQ(35, ((AllOf*) coro)->result());
+	})));
+	unsigned long start = millis();
+	schedule_coro(coroutines, 1, clk_forward);
+	// waited together: the longest, not the sum
+	ASSERT_LT(millis() - start, 80u);
+	ASSERT_EQ(0, CoroPool::in_use());
+	delete g_sched;
+}
+
+COROUTINE(int, AnyOf,
+	CORO_VAR(int8_t, first)
+)
+CORO_START(AnyOf);
+{
+	AWAIT_ANY(first, new Delay(2000), (new CountNumber())->set_limit(3), new Delay(2000));
+	// the losers are deleted
+	ASSERT_EQ(2, CoroPool::in_use());
+	ASSERT_FALSE(HAS_TIMEOUT());
+}
+CORO_RETURN(first * 10 + RESULT(CountNumber));
+CORO_END();
+
+TEST(Coroutine, await_any) {
+	g_sched = new SchedulerClkMock();
+	ICoroutine* coroutines[] = {new AnyOf()};
+	EXPECT_CALL(*g_sched, callback(0, _)).WillOnce(WithArg<1>(Invoke([](const ICoroutine* coro) {
+		ASSERT_EQ(13, ((AnyOf*) coro)->result());
+	})));
+	unsigned long start = millis();
+	schedule_coro(coroutines, 1, clk_forward);
+	ASSERT_LT(millis() - start, 1000u);
+	ASSERT_EQ(0, CoroPool::in_use());
+	delete g_sched;
+}
+
+COROUTINE(int, AwaitGroupExhausted,
+	CORO_VAR(int8_t, first)
+)
+CORO_START(AwaitGroupExhausted);
+{
+	// 2 blocks for 4 subtasks: the last 2 are nullptr
+	AWAIT_ALL(CORO_NEW(CountNumber, set_limit(2)), CORO_NEW(CountNumber, set_limit(3)),
+			CORO_NEW(CountNumber, set_limit(4)), CORO_NEW(CountNumber, set_limit(5)));
+	ASSERT_EQ(2, RESULT_OF(0, CountNumber));
+	ASSERT_EQ(3, RESULT_OF(1, CountNumber));
+	ASSERT_FALSE(HAS_TIMEOUT_OF(1));
+	ASSERT_TRUE(HAS_TIMEOUT_OF(2));
+	ASSERT_TRUE(HAS_TIMEOUT_OF(3));
+	ASSERT_EQ(0, RESULT_OF(2, CountNumber));
+	// the nullptr one is done at once, and wins: nothing owned, all the others deleted
+	AWAIT_ANY(first, CORO_NEW(CountNumber, set_limit(50)), CORO_NEW(CountNumber, set_limit(50)),
+			CORO_NEW(CountNumber, set_limit(50)));
+	ASSERT_EQ(2, first);
+	ASSERT_TRUE(HAS_TIMEOUT());
+	ASSERT_EQ(0, RESULT(CountNumber));
+	ASSERT_EQ(CoroPool::capacity() - 2, CoroPool::in_use());
+	// then a plain AWAIT is not affected
+	AWAIT(CORO_NEW(CountNumber, set_limit(4)));
+	ASSERT_FALSE(HAS_TIMEOUT());
+	ASSERT_EQ(4, RESULT(CountNumber));
+}
+CORO_RETURN(first);
+CORO_END();
+
+TEST(Coroutine, await_exhausted) {
+	g_sched = new SchedulerClkMock();
+	ICoroutine* coroutines[] = {new AwaitGroupExhausted()};
+	std::vector<ICoroutine*> held;
+	while (CoroPool::in_use() < CoroPool::capacity() - 2)
+		held.push_back(new Delay(10000));
+	EXPECT_CALL(*g_sched, callback(0, _)).WillOnce(WithArg<1>(Invoke([](const ICoroutine* coro) {
+		ASSERT_FALSE(((AwaitGroupExhausted*) coro)->has_timeout());
+		ASSERT_EQ(2, ((AwaitGroupExhausted*) coro)->result());
+	})));
+	schedule_coro(coroutines, 1, clk_forward);
+	for (size_t i = 0; i < held.size(); ++i)
+		delete held[i];
+	ASSERT_EQ(0, CoroPool::in_use());
+	delete g_sched;
+}
@@ -1,6 +1,8 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 #include <memory>
+#include <vector>
+#include <stdlib.h>
 
 #include <Arduino.h>
 #include <CoroutineCtx.h>
@@ -132,3 +134,242 @@ TEST(CoroutineCtx, two_countchar) {
 	ASSERT_FALSE(CORO_HAS_TIMEOUT(b));	ASSERT_TRUE(CORO_RESULT(b));
 }
 
+
+/////////////////////////////////////////////////////////////////////
+
+TEST(CoroutineCtx, timer_wheel) {
+	// same expiry as the check in CORO_BEGIN_CTX, across levels and beyond the last one
+	const unsigned long start = 0xFFFFF000UL; // wraps during the test
+	const unsigned long timeouts[] = {0, 1, 5, 63, 64, 65, 127, 4095, 4096, 4097,
+			300000, 1UL << 24, (1UL << 24) + 7, 50000000UL};
+	const int count = sizeof(timeouts) / sizeof(timeouts[0]);
+	CoroTimerWheel<> wheel(start);
+	DelayCtx ctx[count + 200];
+	srand(42);
+	for (int i = 0; i < count + 200; ++i) {
+		CORO_INIT(ctx[i], 0);
+		ctx[i]._start = start;
+		ctx[i]._timeout_ms = i < count ? timeouts[i] : rand() % 100000;
+		wheel.add(ctx[i]);
+	}
+	unsigned long now = start;
+	int expired = 0;
+	while (expired < count + 200) {
+		now += 1 + rand() % (expired < count + 190 ? 700 : 300000);
+		expired += wheel.advance(now);
+		for (int i = 0; i < count + 200; ++i)
+			ASSERT_EQ(CORO_HAS_TIMEOUT(ctx[i]), now - ctx[i]._start > ctx[i]._timeout_ms) << i;
+	}
+	ASSERT_EQ(wheel.advance(now + 100000000UL), 0);
+}
+
+TEST(CoroutineCtx, timer_wheel_many) {
+	// more expiries in one advance than a uint16_t counts
+	const int count = 70000;
+	static DelayCtx ctx[count];
+	CoroTimerWheel<> wheel(0);
+	for (int i = 0; i < count; ++i) {
+		CORO_INIT(ctx[i], 10);
+		ctx[i]._start = 0;
+		wheel.add(ctx[i]);
+	}
+	ASSERT_EQ(wheel.advance(11), (uint32_t) count);
+	ASSERT_TRUE(CORO_HAS_TIMEOUT(ctx[count - 1]));
+}
+
+TEST(CoroutineCtx, timer_wheel_cancel) {
+	CoroTimerWheel<2, 4> wheel(0);
+	DelayCtx a, b, c;
+	CORO_INIT(a, 10);
+	CORO_INIT(b, 10);
+	CORO_INIT(c, 10);
+	a._start = b._start = c._start = 0;
+	wheel.add(a);
+	wheel.add(b);
+	wheel.add(c);
+	// removed from the middle of the slot
+	coro_timer_cancel(b);
+	coro_timer_cancel(b);
+	ASSERT_EQ(wheel.advance(10), 0);
+	ASSERT_EQ(wheel.advance(11), 2);
+	ASSERT_TRUE(CORO_HAS_TIMEOUT(a));
+	ASSERT_TRUE(CORO_ALIVE(b));
+	ASSERT_TRUE(CORO_HAS_TIMEOUT(c));
+	// already due when added: expires on the next advance
+	wheel.add(b);
+	ASSERT_TRUE(CORO_ALIVE(b));
+	ASSERT_EQ(wheel.advance(12), 1);
+	ASSERT_FALSE(CORO_ALIVE(b));
+}
+
+TEST(CoroutineCtx, timer_wheel_counters) {
+	// the coroutines ending remove themselves from the wheel
+	CoroTimerWheel<> wheel;
+	CountNumberCtx a, b;
+	DelayCtx d;
+	CORO_INIT_WHEEL(a, 10*10*10, wheel);
+	a.limit = 10;
+	CORO_INIT_WHEEL(b, 10*10*10, wheel);
+	b.limit = 5;
+	CORO_INIT_WHEEL(d, 50, wheel);
+	while (CORO_ALIVE(a) || CORO_ALIVE(b) || CORO_ALIVE(d)) {
+		wheel.advance();
+		CountNumber(a);
+		CountNumber(b);
+		Delay(d);
+	}
+	ASSERT_FALSE(CORO_HAS_TIMEOUT(a));	ASSERT_EQ(10, CORO_RESULT(a));
+	ASSERT_FALSE(CORO_HAS_TIMEOUT(b));	ASSERT_EQ(5, CORO_RESULT(b));
+	ASSERT_TRUE(CORO_HAS_TIMEOUT(d));
+	ASSERT_EQ(wheel.advance(millis() + 2000), 0);
+}
+
+/////////////////////////////////////////////////////////////////////
+
+/* one overload per context type: the results come typed, no cast */
+struct StaticClbk {
+	std::vector<int> ended;
+	void operator()(uint8_t idx, const CountNumberCtx& ctx) {
+		ended.push_back(idx);
+		ended.push_back(CORO_RESULT(ctx));
+	}
+	void operator()(uint8_t idx, const DelayCtx& ctx) {
+		ended.push_back(idx);
+		ended.push_back(CORO_HAS_TIMEOUT(ctx) ? -1 : 0);
+	}
+};
+
+TEST(CoroutineCtx, static_scheduler) {
+	CountNumberCtx a, b;
+	DelayCtx d;
+	CORO_INIT(a, 10*10*10);
+	a.limit = 4;
+	CORO_INIT(b, 10*10*10);
+	b.limit = 2;
+	CORO_INIT(d, 80);
+	auto scheduler = make_coro_scheduler(CORO_BIND(CountNumber, a), CORO_BIND(Delay, d),
+			CORO_BIND(CountNumber, b));
+	StaticClbk clbk;
+	ASSERT_EQ(3, scheduler.run_once(clbk));
+	scheduler.run(clbk);
+	ASSERT_EQ(std::vector<int>({2, 2, 0, 4, 1, -1}), clbk.ended);
+	// reported once
+	ASSERT_EQ(0, scheduler.run_once(clbk));
+	ASSERT_EQ(6u, clbk.ended.size());
+}
+
+TEST(CoroutineCtx, static_scheduler_wheel) {
+	// timed out by the wheel between two passes: still reported
+	CoroTimerWheel<> wheel(0);
+	DelayCtx d;
+	CORO_INIT(d, 10);
+	d._start = 0;
+	wheel.add(d);
+	auto scheduler = make_coro_scheduler(CORO_BIND(Delay, d));
+	StaticClbk clbk;
+	ASSERT_EQ(1, scheduler.run_once(clbk));
+	ASSERT_EQ(1, wheel.advance(11));
+	ASSERT_EQ(0, scheduler.run_once(clbk));
+	ASSERT_EQ(std::vector<int>({0, -1}), clbk.ended);
+}
+
+TEST(CoroutineCtx, static_scheduler_owned_wheel) {
+	CountNumberCtx a;
+	DelayCtx d, e;
+	CORO_INIT(a, 10*10*10);
+	a.limit = 3;
+	CORO_INIT(d, 40);
+	CORO_INIT(e, 20);
+	auto scheduler = make_coro_wheel_scheduler(CORO_BIND(CountNumber, a), CORO_BIND(Delay, d),
+			CORO_BIND(Delay, e));
+	StaticClbk clbk;
+	// in the wheel from the first pass: the coroutines don't check their timeout any more
+	ASSERT_EQ(3, scheduler.run_once(clbk));
+	ASSERT_NE(nullptr, a._timer_pprev);
+	ASSERT_NE(nullptr, d._timer_pprev);
+	unsigned long start = millis();
+	scheduler.run(clbk);
+	ASSERT_GE(millis() - start, 30u);
+	// e expired by the wheel, a ended after 3 delays of 10 ms and left it, then d expired
+	ASSERT_EQ(std::vector<int>({2, -1, 0, 3, 1, -1}), clbk.ended);
+	ASSERT_EQ(nullptr, a._timer_pprev);
+	ASSERT_EQ(nullptr, d._timer_pprev);
+}
+
+TEST(CoroutineCtx, static_scheduler_owned_wheel_destroyed) {
+	// the live contexts leave the wheel with the scheduler, and check their timeout again
+	DelayCtx d;
+	CORO_INIT(d, 10);
+	{
+		auto scheduler = make_coro_wheel_scheduler(CORO_BIND(Delay, d));
+		StaticClbk clbk;
+		ASSERT_EQ(1, scheduler.run_once(clbk));
+		ASSERT_NE(nullptr, d._timer_pprev);
+	}
+	ASSERT_EQ(nullptr, d._timer_pprev);
+	ASSERT_TRUE(CORO_ALIVE(d));
+	while (CORO_ALIVE(d))
+		Delay(d);
+	ASSERT_TRUE(CORO_HAS_TIMEOUT(d));
+}
+
+/////////////////////////////////////////////////////////////////////
+
+CORO_CTX(bool, Together,
+	int8_t first;
+	DelayCtx d;
+	CountNumberCtx c;
+	CountNumberCtx c2;
+)
+CORO_BEGIN_CTX(Together)
+{
+	CORO_RETURN_CTX(false);
+	CORO_INIT(ctx.d, 40);
+	CORO_INIT(ctx.c, 1000);
+	ctx.c.limit = 3;
+	AWAIT_ALL_CTX(CORO_TASK(Delay, ctx.d), CORO_TASK(CountNumber, ctx.c));
+	ASSERT_TRUE(CORO_HAS_TIMEOUT(ctx.d));
+	ASSERT_FALSE(CORO_HAS_TIMEOUT(ctx.c));
+	ASSERT_EQ(3, CORO_RESULT(ctx.c));
+
+	CORO_INIT(ctx.d, 2000);
+	CORO_INIT(ctx.c, 1000);
+	ctx.c.limit = 5;
+	CORO_INIT(ctx.c2, 1000);
+	ctx.c2.limit = 2;
+	AWAIT_ANY_CTX(ctx.first, CORO_TASK(Delay, ctx.d), CORO_TASK(CountNumber, ctx.c),
+			CORO_TASK(CountNumber, ctx.c2));
+	ASSERT_EQ(2, ctx.first);
+	ASSERT_EQ(2, CORO_RESULT(ctx.c2));
+	// the losers are cancelled
+	ASSERT_FALSE(CORO_ALIVE(ctx.d));
+	ASSERT_TRUE(CORO_HAS_TIMEOUT(ctx.c));
+}
+CORO_RETURN_CTX(true);
+CORO_END_CTX()
+
+TEST(CoroutineCtx, await_all_any) {
+	TogetherCtx t;
+	CORO_INIT(t, 10*1000);
+	unsigned long start = millis();
+	while (CORO_ALIVE(t))
+		Together(t);
+	ASSERT_TRUE(CORO_RESULT(t));
+	// each wait is the shortest or the longest of its subs, not the sum
+	ASSERT_LT(millis() - start, 200u);
+}
+
+TEST(CoroutineCtx, await_any_wheel) {
+	// a cancelled loser leaves its timer wheel
+	CoroTimerWheel<> wheel(0);
+	DelayCtx a, b;
+	CORO_INIT(a, 10);
+	CORO_INIT(b, 1000);
+	a._live = false;
+	wheel.add(b);
+	CoroTask tasks[] = {CORO_TASK(Delay, a), CORO_TASK(Delay, b)};
+	ASSERT_EQ(0, coro_await_any(tasks, 2));
+	ASSERT_FALSE(CORO_ALIVE(b));
+	ASSERT_EQ(nullptr, b._timer_pprev);
+	ASSERT_EQ(0, wheel.advance(2000));
+}
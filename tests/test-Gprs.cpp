@@ -7,12 +7,17 @@
 
 #include <string.h>
 
-#define PRINT_BUFFER(b) fwrite(b.buffer(), 1, b.length(), stdout);
+#define PRINT_BUFFER(b) { auto segs = b.segments(); \
+	fwrite(segs.first.data, 1, segs.first.length, stdout); \
+	fwrite(segs.second.data, 1, segs.second.length, stdout); }
 
 #define AT_TIMEOUT_MS 1000 * 10
 
 #include <RingBuffer.h>
 #include <ATCmd.h>
+#include <AT_CFUN.h>
+#include <AT_DDET.h>
+#include <AT_CSQ.h>
 #include <Gprs.h>
 
 using ::testing::Return;
@@ -23,6 +28,40 @@ using ::testing::WithArgs;
 using ::testing::Invoke;
 using ::testing::HasSubstr;
 
+TEST(AtParsers, straddling_lines) {
+	StringBuffer<32> buff;
+	buff.append("--------------------------");
+	buff.pop_firsts(26);
+	ASSERT_EQ(buff.append("\r\n+CFUN: 4\r\n\r\n+DTMF:#\r\n"), 23);
+	enum AT_CFUN::fun fun = AT_CFUN::MINIMAL;
+	ASSERT_EQ(AT_CFUN::parse(buff, &fun), 1);
+	ASSERT_EQ(fun, AT_CFUN::DISABLE);
+	char tone = 0;
+	ASSERT_EQ(AT_DTMF::parse(buff, &tone), 1);
+	ASSERT_EQ(tone, '#');
+	ASSERT_TRUE(buff.empty());
+	buff.append("\r\n+CSQ: 23,99\r\n");
+	uint8_t rssi = 0, ber = 0;
+	ASSERT_EQ(AT_CSQ::parse(buff, &rssi, &ber), 2);
+	ASSERT_EQ(rssi, 23);
+	ASSERT_EQ(ber, AT_CSQ::UNKNOWN);
+	// out of range: not truncated into the uint8_t, left untouched and not counted
+	buff.append("+CSQ: 300,1\r\n+CSQ: 12,8\r\n");
+	ASSERT_EQ(AT_CSQ::parse(buff, &rssi, &ber), 1);
+	ASSERT_EQ(rssi, 23);
+	ASSERT_EQ(ber, 1);
+	ASSERT_EQ(AT_CSQ::parse(buff, &rssi, &ber), 1);
+	ASSERT_EQ(rssi, 12);
+	ASSERT_EQ(ber, 1);
+	buff.append("+CFUN: 2\r\n");
+	ASSERT_EQ(AT_CFUN::parse(buff, &fun), 0);
+	ASSERT_TRUE(buff.empty());
+	// incomplete line, nothing consumed
+	buff.append("+CFUN: 1\r");
+	ASSERT_EQ(AT_CFUN::parse(buff, &fun), 0);
+	ASSERT_EQ(buff.length(), 9);
+}
+
 class GPRSSerial {
 public:
 
@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include <Arduino.h>
+#include <MirroredRingBuffer.h>
+#include <AT_CFUN.h>
+#include <AT_DDET.h>
+
+TEST(MirroredRingBuffer, wrap_is_continuous) {
+	MirroredRingBuffer<1024, int> buff;
+	ASSERT_TRUE(buff.valid());
+	for (int i = 0; i < 1000; ++i)
+		ASSERT_EQ(buff.append(i), 1);
+	ASSERT_EQ(buff.pop_firsts(900), 900);
+	int src[500];
+	for (int i = 0; i < 500; ++i)
+		src[i] = 1000 + i;
+	ASSERT_EQ(buff.append(src, 500), 500); // goes over the end of the first mapping
+	ASSERT_EQ(buff.length(), 600);
+	const int* arr = buff.buffer();
+	for (int i = 0; i < 600; ++i)
+		ASSERT_EQ(arr[i], 900 + i);
+	ASSERT_EQ(buff.segments().second.length, 0);
+	ASSERT_EQ(buff[599], 1499);
+	ASSERT_EQ(buff.pop_last(), 1499);
+	ASSERT_EQ(buff.pop_first(), 900);
+	int dst[598];
+	ASSERT_EQ(buff.read(dst, 1000), 598);
+	ASSERT_EQ(dst[597], 1498);
+	ASSERT_TRUE(buff.empty());
+}
+
+TEST(MirroredRingBuffer, full) {
+	MirroredRingBuffer<4096, char> buff;
+	char src[4096 + 1] = { 0 };
+	ASSERT_EQ(buff.append(src, sizeof (src)), decltype(buff)::capacity());
+	ASSERT_TRUE(buff.full());
+	ASSERT_EQ(buff.append('A'), 0);
+	buff.clear();
+	ASSERT_TRUE(buff.empty());
+}
+
+TEST(MirroredStringBuffer, megabytes) {
+	static MirroredStringBuffer<4 * 1024 * 1024> buff;
+	ASSERT_TRUE(buff.valid());
+	std::string data(decltype(buff)::capacity() - 10, 'x');
+	ASSERT_EQ(buff.append(data.c_str()), data.length());
+	ASSERT_EQ(buff.pop_firsts(data.length()), data.length());
+	ASSERT_EQ(buff.append("\r\nOK\r\n+CFUN: 1\r\n"), 16);
+	ASSERT_EQ(buff.index_of("OK\r\n"), 2); // straddles the end of the first mapping
+	ASSERT_TRUE(buff.pop_until("OK\r\n"));
+	ASSERT_TRUE(buff.starts_with("+CFUN:"));
+}
+
+TEST(MirroredStringBuffer, string_api) {
+	MirroredStringBuffer<4096> buff;
+	ASSERT_EQ(buff.index_of(""), decltype(buff)::END);
+	ASSERT_EQ(buff.append("   111222333"), 12);
+	ASSERT_FALSE(buff.pop_while('1'));
+	ASSERT_TRUE(buff.pop_while(' '));
+	ASSERT_EQ(buff.index_of("2"), 3);
+	ASSERT_EQ(buff.index_of("3", 7), 7);
+	ASSERT_EQ(buff.index_of("4"), decltype(buff)::END);
+	ASSERT_FALSE(buff.starts_with("2"));
+	ASSERT_TRUE(buff.pop_until("22"));
+	ASSERT_TRUE(buff.starts_with("2333"));
+	ASSERT_FALSE(buff.pop_until("4"));
+}
+
+TEST(MirroredStringBuffer, at_parsers) {
+	MirroredStringBuffer<4096> buff;
+	enum AT_CFUN::fun fun = AT_CFUN::MINIMAL;
+	ASSERT_EQ(buff.append("\r\n+CFUN: 1\r\n\r\n+DTMF:5\r\n"), 23);
+	ASSERT_EQ(AT_CFUN::parse(buff, &fun), 1);
+	ASSERT_EQ(fun, AT_CFUN::FULL);
+	char tone;
+	ASSERT_EQ(AT_DTMF::parse(buff, &tone), 1);
+	ASSERT_EQ(tone, '5');
+	ASSERT_TRUE(buff.empty());
+}
+
+TEST(MirroredStringBuffer, next_line) {
+	MirroredStringBuffer<4096> buff;
+	MirroredStringBuffer<4096>::Line line;
+	ASSERT_FALSE(buff.next_line(&line));
+	buff.append("\r\n+CSQ: 23,0\r\nOK\r");
+	ASSERT_TRUE(buff.find_line("+CSQ:", &line));
+	ASSERT_TRUE(line.equals("+CSQ: 23,0"));
+	ASSERT_FALSE(buff.find_line("OK", &line));
+	buff.append("\n");
+	ASSERT_TRUE(buff.find_line("OK", &line));
+	buff.consume(line);
+	ASSERT_TRUE(buff.empty());
+}
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+#include <Arduino.h>
+#include <MpmcRingBuffer.h>
+
+TEST(MpmcRingBuffer, single_thread) {
+	MpmcRingBuffer<4, int> queue;
+	ASSERT_TRUE(queue.empty());
+	ASSERT_EQ(decltype(queue)::capacity(), 4);
+	for (int i = 0; i < 4; ++i)
+		ASSERT_EQ(queue.append(i), 1);
+	ASSERT_EQ(queue.append(4), 0);
+	ASSERT_EQ(queue.length(), 4);
+	int out[4];
+	ASSERT_EQ(queue.read(out, 3), 3);
+	ASSERT_EQ(out[0], 0);
+	ASSERT_EQ(out[2], 2);
+	// next lap
+	ASSERT_EQ(queue.append(4), 1);
+	ASSERT_EQ(queue.append(5), 1);
+	ASSERT_EQ(queue.read(out, 4), 3);
+	ASSERT_EQ(out[0], 3);
+	ASSERT_EQ(out[2], 5);
+	ASSERT_EQ(queue.read(out, 1), 0);
+	ASSERT_TRUE(queue.empty());
+}
+
+/*
+ * every element pushed by the producers is received exactly once, and in order for a
+ * given producer and a given consumer
+ */
+TEST(MpmcRingBuffer, producers_consumers_threads) {
+	static const uint32_t PRODUCERS = 4, CONSUMERS = 3, COUNT = 20 * 1000;
+	MpmcRingBuffer<32, uint32_t> queue;
+	std::vector<std::thread> threads;
+	std::vector<std::vector<uint32_t> > received(CONSUMERS);
+	std::atomic<uint32_t> total(0);
+
+	for (uint32_t p = 0; p < PRODUCERS; ++p)
+		threads.push_back(std::thread([&queue, p]() {
+			for (uint32_t i = 0; i < COUNT; )
+				if (queue.append(p * COUNT + i))
+					++i;
+				else
+					std::this_thread::yield();
+		}));
+	for (uint32_t c = 0; c < CONSUMERS; ++c)
+		threads.push_back(std::thread([&queue, &received, &total, c]() {
+			uint32_t value;
+			while (total.load() < PRODUCERS * COUNT) {
+				if (queue.read(&value, 1)) {
+					received[c].push_back(value);
+					++total;
+				} else
+					std::this_thread::yield();
+			}
+		}));
+	for (auto& t : threads)
+		t.join();
+
+	std::vector<uint32_t> seen(PRODUCERS * COUNT, 0);
+	for (auto& values : received) {
+		std::vector<int64_t> last(PRODUCERS, -1);
+		for (auto v : values) {
+			++seen[v];
+			ASSERT_GT((int64_t) v, last[v / COUNT]);
+			last[v / COUNT] = v;
+		}
+	}
+	for (auto count : seen)
+		ASSERT_EQ(count, 1);
+	ASSERT_TRUE(queue.empty());
+}
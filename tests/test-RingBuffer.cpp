@@ -1,4 +1,5 @@
 #include <gtest/gtest.h>
+#include <algorithm>
 
 #include <Arduino.h>
 #include <RingBuffer.h>
@@ -221,3 +222,411 @@ TEST(RingBuffer, memmove_append) {
 	ASSERT_EQ(arr[1], 4);
 	ASSERT_EQ(arr[2], 5);
 }
+
+TEST(RingBuffer, power_of_two_free_running) {
+	RingBuffer<4, int> buff;
+	// enough iterations to overflow the uint16_t free-running indexes
+	for (int i = 0; i < 70000; ++i) {
+		ASSERT_EQ(buff.append(i), 1);
+		ASSERT_EQ(buff.append(i + 1), 1);
+		ASSERT_EQ(buff.length(), 2);
+		ASSERT_EQ(buff[1], i + 1);
+		ASSERT_EQ(buff.pop_first(), i);
+		ASSERT_EQ(buff.pop_last(), i + 1);
+		ASSERT_TRUE(buff.empty());
+	}
+	for (auto c : { 1, 2, 3, 4 })
+		ASSERT_EQ(buff.append(c), 1);
+	ASSERT_EQ(buff.append(5), 0);
+	ASSERT_TRUE(buff.full());
+	ASSERT_EQ(buff.pop_firsts(3), 3);
+	for (auto c : { 5, 6, 7 })
+		ASSERT_EQ(buff.append(c), 1);
+	const int *arr = buff.buffer();
+	for (int i = 0; i < 4; ++i)
+		ASSERT_EQ(arr[i], i + 4);
+}
+
+TEST(StringBuffer, power_of_two_matches_modulo) {
+	StringBuffer<8> mask;
+	StringBuffer<7> modulo;
+	const char* data = "+CFUN: 1\r\nOK\r\n";
+	for (uint16_t i = 0; i < 1000; ++i) {
+		char c = data[i % strlen(data)];
+		if (mask.length() == modulo.capacity()) {
+			ASSERT_EQ(mask.pop_first(), modulo.pop_first());
+		}
+		ASSERT_EQ(mask.append(c), modulo.append(c));
+		ASSERT_EQ(mask.length(), modulo.length());
+		for (uint16_t j = 0; j < mask.length(); ++j)
+			ASSERT_EQ(mask[j], modulo[j]);
+		ASSERT_EQ(mask.index_of("OK"), modulo.index_of("OK"));
+	}
+}
+
+TEST(RingBuffer, bulk_append_read) {
+	RingBuffer<5, int> buff;
+	const int src[] = { 1, 2, 3, 4, 5, 6, 7 };
+	int dst[7] = { 0 };
+	ASSERT_EQ(buff.append(src, 3), 3); // |1|2|3| | |
+	ASSERT_EQ(buff.read(dst, 2), 2); // | | |3| | |
+	ASSERT_EQ(dst[0], 1);
+	ASSERT_EQ(dst[1], 2);
+	ASSERT_EQ(buff.append(src + 3, 7 - 3), 4); // |6|7|3|4|5| wrapping
+	ASSERT_TRUE(buff.full());
+	ASSERT_EQ(buff.append(src, 1), 0);
+	ASSERT_EQ(buff.read(dst, 7), 5); // wrapping
+	for (int i = 0; i < 5; ++i)
+		ASSERT_EQ(dst[i], i + 3);
+	ASSERT_TRUE(buff.empty());
+	ASSERT_EQ(buff.read(dst, 1), 0);
+}
+
+TEST(StringBuffer, discard) {
+	StringBuffer<4> buff;
+	ASSERT_EQ(buff.discard(1), 0);
+	ASSERT_EQ(buff.append("ABCD"), 4);
+	ASSERT_EQ(buff.discard(3), 3);
+	ASSERT_EQ(buff.append("EF"), 2);
+	ASSERT_TRUE(buff.starts_with("DEF"));
+	ASSERT_EQ(buff.discard(10), 3);
+	ASSERT_TRUE(buff.empty());
+}
+
+TEST(StringBuffer, segments) {
+	StringBuffer<5> buff;
+	auto segs = buff.segments();
+	ASSERT_EQ(segs.first.length, 0);
+	ASSERT_EQ(segs.second.length, 0);
+	ASSERT_EQ(buff.append("12345"), 5);
+	ASSERT_EQ(buff.pop_firsts(3), 3);
+	segs = buff.segments(); // | | | |4|5|
+	ASSERT_EQ(segs.first.length, 2);
+	ASSERT_EQ(strncmp(segs.first.data, "45", 2), 0);
+	ASSERT_EQ(segs.second.length, 0);
+	ASSERT_EQ(buff.append("678"), 3);
+	segs = buff.segments(); // |6|7|8|4|5|
+	ASSERT_EQ(segs.first.length, 2);
+	ASSERT_EQ(strncmp(segs.first.data, "45", 2), 0);
+	ASSERT_EQ(segs.second.length, 3);
+	ASSERT_EQ(strncmp(segs.second.data, "678", 3), 0);
+	// segments() must not have touched the content
+	ASSERT_EQ(buff.segments().first.data, segs.first.data);
+}
+
+TEST(RingBuffer, buffer_rotation) {
+	RingBuffer<7, int> buff;
+	for (int shift = 0; shift < 7; ++shift) {
+		buff.clear();
+		for (int i = 0; i < shift; ++i)
+			ASSERT_EQ(buff.append(-1), 1);
+		ASSERT_EQ(buff.pop_firsts(shift), shift);
+		for (int i = 0; i < 6; ++i)
+			ASSERT_EQ(buff.append(i), 1);
+		const int* arr = buff.buffer();
+		for (int i = 0; i < 6; ++i)
+			ASSERT_EQ(arr[i], i);
+		// indexes must still be consistent after the rotation
+		ASSERT_EQ(buff.append(6), 1);
+		ASSERT_TRUE(buff.full());
+		for (int i = 0; i < 7; ++i)
+			ASSERT_EQ(buff.pop_first(), i);
+	}
+}
+
+/* two indexes of the smallest type able to hold Size, nothing else */
+static_assert(sizeof (StringBuffer<16>) == 16 + 2 * sizeof (uint8_t), "uint8_t indexes up to 255");
+static_assert(sizeof (StringBuffer<255>) == 255 + 2 * sizeof (uint8_t), "uint8_t indexes up to 255");
+static_assert(sizeof (StringBuffer<256>) == 256 + 2 * sizeof (uint16_t), "uint16_t indexes up to 65535");
+static_assert(sizeof (StringBuffer<1000>) == 1000 + 2 * sizeof (uint16_t), "uint16_t indexes up to 65535");
+static_assert(sizeof (StringBuffer<100000>) == 100000 + 2 * sizeof (uint32_t), "uint32_t indexes above");
+static_assert(sizeof (StringBuffer<100>::size_type) == sizeof (uint16_t), "API unchanged below 65536");
+static_assert(sizeof (StringBuffer<100000>::size_type) == sizeof (uint32_t), "32 bits API above");
+
+TEST(StringBuffer, above_64k) {
+	static StringBuffer<100000> buff;
+	std::string data(70000, 'x');
+	ASSERT_EQ(buff.append(data.c_str()), 70000);
+	ASSERT_EQ(buff.append(data.c_str()), 30000);
+	ASSERT_TRUE(buff.full());
+	ASSERT_EQ(buff.pop_firsts(69990), 69990);
+	ASSERT_EQ(buff.append("OK\r\n"), 4); // wrapping
+	ASSERT_EQ(buff.index_of("OK\r\n"), 30010);
+	ASSERT_EQ(buff[30011], 'K');
+	ASSERT_EQ(buff.pop_last(), '\n');
+	ASSERT_EQ(buff.length(), 30013);
+}
+
+TEST(StringBuffer, small_power_of_two_overflow) {
+	StringBuffer<128> buff; // uint8_t free-running indexes
+	for (uint16_t i = 0; i < 1000; ++i) {
+		ASSERT_EQ(buff.append("0123456789"), 10);
+		ASSERT_EQ(buff.index_of("89"), 8);
+		ASSERT_EQ(buff.pop_firsts(10), 10);
+		ASSERT_TRUE(buff.empty());
+	}
+	ASSERT_EQ(buff.append(std::string(200, 'y').c_str()), 128);
+	ASSERT_EQ(buff.length(), 128);
+}
+
+TEST(RingBuffer, overflow_drop_new) {
+	RingBuffer<3, int, RingDropNew> buff;
+	const int src[] = { 1, 2, 3, 4, 5 };
+	ASSERT_EQ(buff.append(src, 5), 3);
+	ASSERT_EQ(buff.append(6), 0);
+	ASSERT_EQ(buff[0], 1);
+	ASSERT_EQ(buff[2], 3);
+}
+
+TEST(RingBuffer, overflow_overwrite_old) {
+	RingBuffer<3, int, RingOverwriteOld> buff;
+	const int src[] = { 1, 2, 3, 4, 5 };
+	ASSERT_EQ(buff.append(src, 2), 2);
+	ASSERT_EQ(buff.append(src + 2, 2), 2); // evicts 1
+	ASSERT_EQ(buff.length(), 3);
+	ASSERT_EQ(buff[0], 2);
+	ASSERT_EQ(buff.append(6), 1); // evicts 2
+	ASSERT_EQ(buff.pop_first(), 3);
+	ASSERT_EQ(buff.pop_first(), 4);
+	ASSERT_EQ(buff.pop_first(), 6);
+	ASSERT_EQ(buff.append(src, 5), 3); // only the last 3 are kept
+	ASSERT_EQ(buff[0], 3);
+	ASSERT_EQ(buff[2], 5);
+	ASSERT_TRUE(buff.full());
+}
+
+TEST(StringBuffer, overflow_overwrite_old) {
+	StringBuffer<8, RingOverwriteOld> history;
+	ASSERT_EQ(history.append("AT+CPIN?\r\n"), 8);
+	ASSERT_TRUE(history.starts_with("+CPIN?\r\n"));
+	ASSERT_EQ(history.append("OK"), 2);
+	ASSERT_TRUE(history.starts_with("PIN?\r\nOK"));
+}
+
+TEST(StringBuffer, overflow_report) {
+	StringBuffer<4, RingReportOverflow> buff;
+	ASSERT_EQ(buff.overflows(), 0);
+	ASSERT_EQ(buff.append("123456"), 4);
+	ASSERT_EQ(buff.overflows(), 2);
+	ASSERT_EQ(buff.append('7'), 0);
+	ASSERT_EQ(buff.overflows(), 3);
+	ASSERT_TRUE(buff.starts_with("1234"));
+	buff.reset_overflows();
+	ASSERT_EQ(buff.overflows(), 0);
+}
+
+TEST(StringBuffer, iterators) {
+	StringBuffer<8> buff;
+	ASSERT_EQ(buff.begin(), buff.end());
+	ASSERT_EQ(buff.append("xxxxx"), 5);
+	ASSERT_EQ(buff.pop_firsts(5), 5);
+	ASSERT_EQ(buff.append("+CPIN: READY"), 8); // wraps after "+CP"
+	ASSERT_EQ(buff.end() - buff.begin(), 8);
+	ASSERT_EQ(*(buff.begin() + 3), 'I');
+	ASSERT_EQ(buff.begin()[6], ' ');
+	std::string copy;
+	for (char c : buff)
+		copy += c;
+	ASSERT_EQ(copy, "+CPIN: R");
+	char out[8];
+	std::copy(buff.begin(), buff.end(), out);
+	ASSERT_EQ(strncmp(out, "+CPIN: R", 8), 0);
+	auto it = std::find(buff.begin(), buff.end(), ':');
+	ASSERT_EQ(it.index(), 5);
+	const char token[] = "PIN";
+	it = std::search(buff.begin(), buff.end(), token, token + 3);
+	ASSERT_EQ(it - buff.begin(), 2);
+	ASSERT_EQ(std::reverse_iterator<decltype(it)>(buff.end())[0], 'R');
+}
+
+TEST(RingBuffer, iterator_arithmetic) {
+	RingBuffer<5, int> buff;
+	for (auto c : { 0, 0, 0, 1, 2 })
+		ASSERT_EQ(buff.append(c), 1);
+	ASSERT_EQ(buff.pop_firsts(3), 3);
+	for (auto c : { 3, 4, 5 })
+		ASSERT_EQ(buff.append(c), 1);
+	auto it = buff.end();
+	--it;
+	ASSERT_EQ(*it, 5);
+	it -= 3;
+	ASSERT_EQ(*it, 2);
+	ASSERT_EQ(*it++, 2);
+	ASSERT_EQ(*it, 3);
+	ASSERT_TRUE(buff.begin() < it);
+	ASSERT_EQ(std::distance(buff.begin(), buff.end()), 5);
+	int sum = 0;
+	for (auto i = buff.begin(); i != buff.end(); ++i)
+		sum += *i;
+	ASSERT_EQ(sum, 15);
+}
+
+TEST(StringBuffer, index_of_straddling) {
+	StringBuffer<10> buff;
+	ASSERT_EQ(buff.append("xxxxxxx"), 7);
+	ASSERT_EQ(buff.pop_firsts(7), 7);
+	ASSERT_EQ(buff.append("O\r\nOK\r\nOK"), 9); // |K\r\nOK\r\nO|O\r\n|
+	ASSERT_EQ(buff.index_of("OK\r\n"), 3);
+	ASSERT_EQ(buff.index_of("O\r\nO"), 0);
+	ASSERT_EQ(buff.index_of("\r\nOK\r"), 1);
+	ASSERT_EQ(buff.index_of("K\r\nOK"), 4);
+	ASSERT_EQ(buff.index_of("OK", 4), 7);
+	ASSERT_EQ(buff.index_of("OK\r\n", 4), decltype(buff)::END);
+	ASSERT_EQ(buff.index_of("", 9), 9);
+	ASSERT_TRUE(buff.starts_with("O\r\nOK"));
+	ASSERT_FALSE(buff.starts_with("O\r\nOO"));
+	ASSERT_FALSE(buff.starts_with("O\r\nOK\r\nOK!"));
+}
+
+/* memchr/memcmp search compared to a naive search, on every alignment of the content */
+TEST(StringBuffer, index_of_matches_naive) {
+	const char* data = "+CPIN: SIM PIN\r\n\r\nOK\r\n+CFUN: 1\r\n";
+	const char* tokens[] = { "OK\r\n", "\r\n", "+C", "PIN", "\r\n\r\n", "+CFUN: 1\r\n", "N", "ERROR" };
+	StringBuffer<40> buff;
+	for (uint16_t shift = 0; shift < 40; ++shift) {
+		buff.clear();
+		std::string filler(shift, '-');
+		buff.append(filler.c_str());
+		buff.pop_firsts(shift);
+		buff.append(data);
+		for (auto token : tokens) {
+			for (uint16_t offset = 0; offset < buff.length(); ++offset) {
+				std::string content(buff.begin(), buff.end());
+				size_t expected = content.find(token, offset);
+				ASSERT_EQ(buff.index_of(token, offset), expected == std::string::npos ? decltype(buff)::END : expected);
+			}
+		}
+	}
+}
+
+TEST(StringBuffer, next_line) {
+	StringBuffer<32> buff;
+	StringBuffer<32>::Line line;
+	ASSERT_FALSE(buff.next_line(&line));
+	buff.append("\r\n+CSQ: 23,0\r\nOK\r");
+	ASSERT_TRUE(buff.next_line(&line));
+	ASSERT_TRUE(line.empty());
+	ASSERT_EQ(line.offset(), 0);
+	ASSERT_TRUE(buff.next_line(&line, 2));
+	ASSERT_TRUE(line.equals("+CSQ: 23,0"));
+	ASSERT_EQ(line.offset(), 2);
+	// "OK\r" is not complete yet
+	ASSERT_FALSE(buff.next_line(&line, 14));
+	ASSERT_FALSE(buff.next_line(&line, 32));
+	buff.append("\n");
+	ASSERT_TRUE(buff.next_line(&line, 14));
+	ASSERT_TRUE(line.equals("OK"));
+	// a '\n' alone does not end the line
+	buff.clear();
+	buff.append("a\nb\r\n");
+	ASSERT_TRUE(buff.next_line(&line));
+	ASSERT_TRUE(line.equals("a\nb"));
+}
+
+TEST(StringBuffer, next_line_straddling) {
+	StringBuffer<16> buff;
+	buff.append("------------");
+	buff.pop_firsts(12);
+	buff.append("+DTMF: 5\r\nOK\r\n");
+	ASSERT_NE(buff.segments().second.length, 0);
+	StringBuffer<16>::Line line;
+	ASSERT_TRUE(buff.find_line("+DTMF:", &line));
+	ASSERT_EQ(line.length(), 8);
+	StringBuffer<16>::Line value = line.substr(6).trim_left();
+	ASSERT_TRUE(value.equals("5"));
+	ASSERT_EQ(std::string(line.begin(), line.end()), "+DTMF: 5");
+	buff.consume(line);
+	ASSERT_TRUE(buff.find_line("OK", &line));
+	ASSERT_EQ(line.offset(), 0);
+	buff.consume(line);
+	ASSERT_TRUE(buff.empty());
+	// "\r" ends the first segment, "\n" starts the second one
+	buff.clear();
+	buff.append("------------");
+	buff.pop_firsts(12);
+	buff.append("abc\r\n");
+	ASSERT_EQ(buff.segments().first.length, 4);
+	ASSERT_TRUE(buff.next_line(&line));
+	ASSERT_TRUE(line.equals("abc"));
+}
+
+TEST(StringBuffer, line_view) {
+	StringBuffer<32> buff;
+	StringBuffer<32>::Line line;
+	buff.append("+CMGS: 12,\"x\"\r\n");
+	ASSERT_TRUE(buff.next_line(&line));
+	ASSERT_TRUE(line.starts_with("+CMGS:"));
+	ASSERT_FALSE(line.starts_with("+CMGS: 12,\"x\"!"));
+	ASSERT_FALSE(line.equals("+CMGS:"));
+	ASSERT_EQ(line.index_of(','), 9);
+	ASSERT_EQ(line.index_of(',', 10), StringBuffer<32>::Line::END);
+	ASSERT_EQ(line[7], '1');
+	ASSERT_TRUE(line.substr(7, 2).equals("12"));
+	ASSERT_TRUE(line.substr(40).empty());
+	ASSERT_TRUE(line.substr(10, 40).equals("\"x\""));
+	ASSERT_FALSE(buff.find_line("OK", &line));
+}
+
+TEST(StringBuffer, parse_numbers) {
+	StringBuffer<32> buff;
+	buff.append("------------------------");
+	buff.pop_firsts(24);
+	// the number spans the wrap
+	buff.append("1234567,-42,+7,x,4294967296");
+	ASSERT_NE(buff.segments().second.length, 0);
+	StringBuffer<32>::Line all = buff.view();
+	uint32_t u = 0;
+	int32_t i = 0;
+	ASSERT_EQ(all.parse_uint(&u), 7);
+	ASSERT_EQ(u, 1234567);
+	ASSERT_EQ(all.field(1).parse_int(&i), 3);
+	ASSERT_EQ(i, -42);
+	ASSERT_EQ(all.field(1).parse_uint(&u), 0);
+	ASSERT_EQ(all.field(2).parse_int(&i), 2);
+	ASSERT_EQ(i, 7);
+	ASSERT_EQ(all.field(3).parse_int(&i), 0);
+	ASSERT_EQ(i, 7);
+	// overflow
+	ASSERT_EQ(all.field(4).parse_uint(&u), 0);
+	ASSERT_EQ(buff.view(all.length() - 10, 9).parse_uint(&u), 9);
+	ASSERT_EQ(u, 429496729);
+	ASSERT_TRUE(all.field(5).empty());
+	buff.clear();
+	buff.append("-2147483648,2147483648");
+	ASSERT_EQ(buff.view().field(0).parse_int(&i), 11);
+	ASSERT_EQ(i, INT32_MIN);
+	ASSERT_EQ(buff.view().field(1).parse_int(&i), 0);
+	buff.clear();
+	buff.append("4294967295");
+	ASSERT_EQ(buff.view().parse_uint(&u), 10);
+	ASSERT_EQ(u, 4294967295UL);
+}
+
+TEST(StringBuffer, parse_fields) {
+	StringBuffer<64> buff;
+	StringBuffer<64>::Line line, field, text;
+	buff.append("+CMGL: 3,\"REC UNREAD\",\"+33,600\",,\"21/01/01\"\r\n");
+	ASSERT_TRUE(buff.find_line("+CMGL:", &line));
+	StringBuffer<64>::Line value = line.substr(6).trim_left();
+	uint16_t pos = 0;
+	uint32_t index = 0;
+	ASSERT_TRUE(value.next_field(&pos, &field));
+	ASSERT_EQ(field.parse_uint(&index), 1);
+	ASSERT_EQ(index, 3);
+	ASSERT_TRUE(value.next_field(&pos, &field));
+	ASSERT_EQ(field.parse_quoted(&text), 12);
+	ASSERT_TRUE(text.equals("REC UNREAD"));
+	// the comma between quotes is not a separator
+	ASSERT_TRUE(value.next_field(&pos, &field));
+	ASSERT_EQ(field.parse_quoted(&text), 9);
+	ASSERT_TRUE(text.equals("+33,600"));
+	ASSERT_TRUE(value.next_field(&pos, &field));
+	ASSERT_TRUE(field.empty());
+	ASSERT_TRUE(value.next_field(&pos, &field));
+	ASSERT_TRUE(field.equals("\"21/01/01\""));
+	ASSERT_FALSE(value.next_field(&pos, &field));
+	ASSERT_TRUE(value.field(4).equals("\"21/01/01\""));
+	// unterminated
+	ASSERT_EQ(buff.view(0, 20).field(1).parse_quoted(&text), 0);
+	ASSERT_EQ(value.parse_quoted(&text), 0);
+}
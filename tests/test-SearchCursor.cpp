@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <Arduino.h>
+#include <RingBuffer.h>
+#include <SearchCursor.h>
+#ifdef __linux__
+#include <MirroredRingBuffer.h>
+#endif
+
+TEST(SearchCursor, poll) {
+	StringBuffer<16> buff;
+	SearchCursor<StringBuffer<16> > ok(buff, "OK\r\n");
+	ASSERT_EQ(ok.poll(), buff.END);
+	buff.append("12O");
+	ASSERT_EQ(ok.poll(), buff.END);
+	// "O" may start the token, it is kept to be rescanned
+	ASSERT_EQ(ok.scanned(), 0);
+	buff.append("K");
+	ASSERT_EQ(ok.poll(), buff.END);
+	ASSERT_EQ(ok.scanned(), 1);
+	buff.append("\r\n");
+	ASSERT_EQ(ok.poll(), 2);
+	// found once, not scanned again
+	buff.append("OK\r\n");
+	ASSERT_EQ(ok.poll(), 2);
+}
+
+TEST(SearchCursor, consumed) {
+	StringBuffer<16> buff;
+	SearchCursor<StringBuffer<16> > ok(buff, "OK");
+	buff.append("--OK--OK");
+	ASSERT_EQ(ok.poll(), 2);
+	ASSERT_EQ(ok.pop_first(), '-');
+	ASSERT_EQ(ok.poll(), 1);
+	ASSERT_TRUE(ok.pop_until());
+	ASSERT_EQ(buff.length(), 4);
+	ASSERT_EQ(ok.poll(), 2);
+	ASSERT_EQ(ok.pop_firsts(3), 3);
+	ASSERT_EQ(ok.poll(), buff.END);
+	ASSERT_EQ(ok.pop_firsts(8), 1);
+	ASSERT_EQ(ok.pop_first(), buff[0]);
+	ASSERT_EQ(ok.scanned(), 0);
+	ASSERT_FALSE(ok.pop_until());
+	// popped from the buffer itself
+	buff.append("abcdef");
+	ASSERT_EQ(ok.poll(), buff.END);
+	buff.pop_firsts(4);
+	ok.consumed(4);
+	buff.append("OK");
+	ASSERT_EQ(ok.poll(), 2);
+	// cleared behind its back
+	buff.clear();
+	buff.append("O");
+	ok.reset();
+	ASSERT_EQ(ok.poll(), buff.END);
+	buff.append("K");
+	ASSERT_EQ(ok.poll(), 0);
+}
+
+/*
+ * appending random chunks and consuming random amounts, the cursor agrees with index_of
+ */
+TEST(SearchCursor, matches_index_of) {
+	StringBuffer<64> buff;
+	SearchCursor<StringBuffer<64> > cursor(buff, "aab");
+	srand(7);
+	for (int i = 0; i < 5000; ++i) {
+		int chunk = rand() % 6;
+		for (int j = 0; j < chunk && !buff.full(); ++j)
+			buff.append("ab"[rand() % 2]);
+		if (rand() % 4 == 0)
+			cursor.pop_firsts(rand() % 8);
+		else if (rand() % 8 == 0)
+			cursor.pop_until();
+		ASSERT_EQ(cursor.poll(), buff.index_of("aab"));
+		if (buff.full())
+			cursor.pop_firsts(32);
+	}
+}
+
+#ifdef __linux__
+TEST(SearchCursor, mirrored) {
+	MirroredStringBuffer<4096> buff;
+	ASSERT_TRUE(buff.valid());
+	SearchCursor<MirroredStringBuffer<4096> > ok(buff, "OK\r\n");
+	buff.append("+CMGL: 1\r\nO");
+	ASSERT_EQ(ok.poll(), buff.END);
+	buff.append("K\r\n");
+	ASSERT_EQ(ok.poll(), 10);
+	ASSERT_TRUE(ok.pop_until());
+	ASSERT_TRUE(buff.empty());
+}
+#endif
@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+#include <thread>
+
+#include <Arduino.h>
+#include <SpscRingBuffer.h>
+
+TEST(SpscRingBuffer, single_thread) {
+	SpscRingBuffer<4, char> buff;
+	ASSERT_TRUE(buff.empty());
+	ASSERT_EQ(decltype(buff)::capacity(), 4);
+	ASSERT_EQ(buff.append("123", 3), 3);
+	ASSERT_EQ(buff.length(), 3);
+	ASSERT_EQ(buff[2], '3');
+	ASSERT_EQ(buff.pop_first(), '1');
+	ASSERT_EQ(buff.append("456", 3), 2); // wrapping
+	ASSERT_TRUE(buff.full());
+	ASSERT_EQ(buff.append('7'), 0);
+	char out[4];
+	ASSERT_EQ(buff.read(out, 4), 4);
+	ASSERT_EQ(strncmp(out, "2345", 4), 0);
+	ASSERT_TRUE(buff.empty());
+	ASSERT_EQ(buff.discard(1), 0);
+	ASSERT_EQ(buff.append('8'), 1);
+	ASSERT_EQ(buff.discard(2), 1);
+	ASSERT_TRUE(buff.empty());
+}
+
+TEST(SpscRingBuffer, free_running_overflow) {
+	SpscRingBuffer<2, uint16_t> buff;
+	for (uint32_t i = 0; i < 70000; ++i) {
+		ASSERT_EQ(buff.append(i), 1);
+		ASSERT_EQ(buff.length(), 1);
+		ASSERT_EQ(buff.pop_first(), (uint16_t)i);
+	}
+}
+
+/*
+ * a real producer thread, like the UART RX interrupt, and a real consumer thread, like loop()
+ */
+TEST(SpscRingBuffer, producer_consumer_threads) {
+	static const uint32_t COUNT = 200 * 1000;
+	SpscRingBuffer<64, uint32_t> buff;
+
+	std::thread producer([&buff]() {
+		for (uint32_t i = 0; i < COUNT; ) {
+			uint16_t count;
+			if (i % 3 == 0) {
+				uint32_t chunk[] = { i, i + 1, i + 2 };
+				count = buff.append(chunk, i + 3 <= COUNT ? 3 : COUNT - i);
+			} else {
+				count = buff.append(i);
+			}
+			if (count == 0)
+				std::this_thread::yield(); // full, let the consumer run
+			i += count;
+		}
+	});
+
+	uint32_t expected = 0;
+	bool in_order = true;
+	std::thread consumer([&buff, &expected, &in_order]() {
+		uint32_t chunk[5];
+		while (expected < COUNT) {
+			uint16_t count = buff.read(chunk, 5);
+			if (count == 0)
+				std::this_thread::yield(); // empty, let the producer run
+			for (uint16_t i = 0; i < count; ++i)
+				in_order = in_order && chunk[i] == expected++;
+		}
+	});
+
+	producer.join();
+	consumer.join();
+	ASSERT_TRUE(in_order);
+	ASSERT_EQ(expected, COUNT);
+	ASSERT_TRUE(buff.empty());
+}
@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <Arduino.h>
+#include <RingBuffer.h>
+#include <TokenMatcher.h>
+#include <ATCmd.h>
+#ifdef __linux__
+#include <MirroredRingBuffer.h>
+#endif
+
+TOKEN_TABLE(HerTokens, "he", "she", "his", "hers")
+
+// tokens sharing prefixes, and one being the suffix of another
+TOKEN_TABLE(PrefixTokens, "ab", "abcd", "bc", "c", "dab")
+
+TEST(TokenMatcher, sizes) {
+	ASSERT_EQ(TokenMatcher<HerTokens>::count(), 4);
+	ASSERT_EQ(TokenMatcher<HerTokens>::length(1), 3);
+	ASSERT_EQ(TokenMatcher<HerTokens>::length(3), 4);
+	ASSERT_GT(TokenMatcher<HerTokens>::flash_size(), 0);
+}
+
+TEST(TokenMatcher, find) {
+	typedef TokenMatcher<HerTokens> Matcher;
+	StringBuffer<16> buff;
+	uint16_t pos = 0;
+	ASSERT_EQ(Matcher::find(buff, &pos), Matcher::NONE);
+	buff.append("xyz");
+	ASSERT_EQ(Matcher::find(buff, &pos), Matcher::NONE);
+	buff.clear();
+	// "she" and "he" end together, the longest is reported
+	buff.append("ushers");
+	ASSERT_EQ(Matcher::find(buff, &pos), 1);
+	ASSERT_EQ(pos, 1);
+	ASSERT_EQ(Matcher::find(buff, &pos, 2), 0);
+	ASSERT_EQ(pos, 2);
+	ASSERT_EQ(Matcher::find(buff, &pos, 3), Matcher::NONE);
+	ASSERT_EQ(Matcher::find(buff, &pos, 16), Matcher::NONE);
+	buff.clear();
+	buff.append("ahishe");
+	ASSERT_EQ(Matcher::find(buff, &pos), 2);
+	ASSERT_EQ(pos, 1);
+}
+
+TEST(TokenMatcher, find_straddling) {
+	typedef TokenMatcher<HerTokens> Matcher;
+	StringBuffer<8> buff;
+	buff.append("------");
+	buff.pop_firsts(6);
+	// "hers" spans the end and the beginning of the storage
+	buff.append("xhers");
+	ASSERT_EQ(buff.segments().second.length, 3);
+	uint16_t pos = 0;
+	ASSERT_EQ(Matcher::find(buff, &pos), 0);
+	ASSERT_EQ(pos, 1);
+	ASSERT_EQ(Matcher::find(buff, &pos, 2), Matcher::NONE);
+}
+
+/*
+ * reference: the first end position where a token ends, the longest token there
+ */
+template<typename Tokens>
+static uint8_t naive_find(const char* str, size_t offset, size_t* position) {
+	size_t length = strlen(str);
+	for (size_t end = offset; end < length; ++end) {
+		uint8_t found = 0xFF;
+		size_t found_length = 0;
+		for (uint8_t t = 0; t < Tokens::count(); ++t) {
+			size_t l = strlen(Tokens::token(t));
+			if (l > end + 1 - offset || l <= found_length)
+				continue;
+			if (strncmp(str + end + 1 - l, Tokens::token(t), l) == 0) {
+				found = t;
+				found_length = l;
+			}
+		}
+		if (found != 0xFF) {
+			*position = end + 1 - found_length;
+			return found;
+		}
+	}
+	return 0xFF;
+}
+
+TEST(TokenMatcher, find_matches_naive) {
+	typedef TokenMatcher<PrefixTokens> Matcher;
+	StringBuffer<32> buff;
+	char str[33];
+	srand(42);
+	for (int i = 0; i < 2000; ++i) {
+		size_t length = rand() % 32;
+		for (size_t j = 0; j < length; ++j)
+			str[j] = "abcdx"[rand() % 5];
+		str[length] = '\0';
+		// empty, but starting anywhere: str is split in two at the end of the storage
+		buff.clear();
+		size_t shift = rand() % 32;
+		buff.append("--------------------------------", shift);
+		buff.pop_firsts(shift);
+		buff.append(str);
+		for (size_t offset = 0; offset <= length; ++offset) {
+			size_t expected_pos = 0;
+			uint16_t pos = 0;
+			uint8_t expected = naive_find<PrefixTokens>(str, offset, &expected_pos);
+			ASSERT_EQ(Matcher::find(buff, &pos, offset), expected) << str << " from " << offset;
+			if (expected != Matcher::NONE) {
+				ASSERT_EQ(pos, expected_pos) << str << " from " << offset;
+			}
+		}
+	}
+}
+
+TEST(TokenMatcher, at_tokens) {
+	StringBuffer<64> buff;
+	uint16_t pos = 0;
+	buff.append("\r\n+CPIN: READY\r\n\r\nOK\r\n");
+	ASSERT_EQ(AtMatcher::find(buff, &pos), AT_TOKEN_CPIN);
+	ASSERT_EQ(pos, 2);
+	ASSERT_EQ(AtMatcher::find(buff, &pos, pos + 1), AT_TOKEN_OK);
+	ASSERT_EQ(pos, 18);
+	buff.clear();
+	buff.append("\r\n+CME ERROR: 10\r\n");
+	ASSERT_EQ(AtMatcher::find(buff, &pos), AtMatcher::NONE);
+	buff.clear();
+	buff.append("\r\nERROR\r\n");
+	ASSERT_EQ(AtMatcher::find(buff, &pos), AT_TOKEN_ERROR);
+	ASSERT_EQ(pos, 2);
+}
+
+#ifdef __linux__
+TEST(TokenMatcher, mirrored) {
+	MirroredStringBuffer<4096> buff;
+	ASSERT_TRUE(buff.valid());
+	uint32_t pos = 0;
+	buff.append("\r\n+DTMF: 1\r\n");
+	ASSERT_EQ(AtMatcher::find(buff, &pos), AT_TOKEN_DTMF);
+	ASSERT_EQ(pos, 2);
+}
+#endif